@@ -0,0 +1,153 @@
+#ifndef FRAMEDESCRIPTOR_H
+#define FRAMEDESCRIPTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+
+#define FRAME_MODALITY_FLIM			0
+#define FRAME_MODALITY_DPC			1
+
+#define SCAN_DIR_FORWARD			0
+#define SCAN_DIR_BACKWARD			1
+
+#define MAX_FRAME_STAGES			4 // stage timing log entries
+#define N_LATENCY_BINS				24 // log2 histogram of the end-to-end latency (1 us ~ 8 s)
+
+
+// Metadata travelling with a pooled buffer from the acquisition callback to the sink
+struct FrameDescriptor
+{
+	uint64_t seq = 0; // acquisition sequence number (buffer count of the digitizer / camera)
+	uint64_t timestamp_ns = 0; // steady clock at the acquisition callback
+	int line_offset = 0; // FLIm: line of the buffer within the frame (flying-back lines included)
+	int piece = 0; // FLIm: piece of the line carried by the buffer
+	int scan_dir = SCAN_DIR_FORWARD;
+	int modality = FRAME_MODALITY_FLIM;
+	int illum_pattern = -1; // DPC: illumination pattern (-1: none)
+	int lease = -1; // buffer lent by the source (e.g. DMA memory processed in place, -1: pool buffer of the edge)
+
+	// Stage timing log: steady clock when each stage finished with the buffer
+	int n_stages = 0;
+	uint64_t stage_ns[MAX_FRAME_STAGES] = { 0, };
+
+	static inline uint64_t now()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	inline void stamp()
+	{
+		if (n_stages < MAX_FRAME_STAGES)
+			stage_ns[n_stages++] = now();
+	}
+};
+
+
+// End-to-end accounting at a sink: latency histogram, lost & out-of-order frames by acquisition sequence number.
+// Written by the sink thread, read & reset by the GUI thread.
+class FrameMonitor
+{
+public:
+	FrameMonitor() { reset(); }
+
+private: // Not to call copy constrcutor and copy assignment operator
+	FrameMonitor(const FrameMonitor&);
+	FrameMonitor& operator=(const FrameMonitor&);
+
+public:
+	// Sink thread: the descriptor of a buffer done with the last stage
+	void record(const FrameDescriptor& desc)
+	{
+		frames.fetch_add(1, std::memory_order_relaxed);
+
+		if (started)
+		{
+			if (desc.seq > next_seq)
+				lost.fetch_add(desc.seq - next_seq, std::memory_order_relaxed);
+			else if (desc.seq < next_seq)
+				out_of_order.fetch_add(1, std::memory_order_relaxed);
+		}
+		started = true;
+		next_seq = (std::max)(next_seq, desc.seq + 1);
+
+		uint64_t end_ns = desc.n_stages ? desc.stage_ns[desc.n_stages - 1] : FrameDescriptor::now();
+		uint64_t usec = (end_ns > desc.timestamp_ns) ? (end_ns - desc.timestamp_ns) / 1000 : 0;
+		int bin = 0;
+		while ((usec >> bin) && (bin < N_LATENCY_BINS - 1)) bin++;
+		histogram[bin].fetch_add(1, std::memory_order_relaxed);
+
+		uint64_t max = max_usec.load(std::memory_order_relaxed);
+		if (usec > max) max_usec.store(usec, std::memory_order_relaxed);
+
+		uint64_t prev_ns = desc.timestamp_ns;
+		for (int i = 0; i < desc.n_stages; i++)
+		{
+			stage_usec[i].fetch_add((desc.stage_ns[i] - prev_ns) / 1000, std::memory_order_relaxed);
+			prev_ns = desc.stage_ns[i];
+		}
+		if (desc.n_stages > n_stages.load(std::memory_order_relaxed))
+			n_stages.store(desc.n_stages, std::memory_order_relaxed);
+	}
+
+	// Not thread safe: before the sink starts
+	void reset()
+	{
+		frames = 0; lost = 0; out_of_order = 0;
+		max_usec = 0;
+		n_stages = 0;
+		for (int i = 0; i < N_LATENCY_BINS; i++) histogram[i] = 0;
+		for (int i = 0; i < MAX_FRAME_STAGES; i++) stage_usec[i] = 0;
+		next_seq = 0;
+		started = false;
+	}
+
+	// Upper bound of the bin holding the given fraction of the frames [msec]
+	double percentile(double p) const
+	{
+		uint64_t n = frames.load(std::memory_order_relaxed), count = 0;
+		if (n == 0) return 0.0;
+		for (int bin = 0; bin < N_LATENCY_BINS; bin++)
+		{
+			count += histogram[bin].load(std::memory_order_relaxed);
+			if ((double)count >= p * (double)n)
+				return (double)(1ULL << bin) / 1000.0;
+		}
+		return (double)max_usec.load(std::memory_order_relaxed) / 1000.0;
+	}
+
+	std::string report() const
+	{
+		uint64_t n = frames.load(std::memory_order_relaxed);
+
+		char msg[256];
+		int len = sprintf(msg, "frames %llu, lost %llu, out-of-order %llu, latency p50 < %.2f ms, p99 < %.2f ms, max %.2f ms",
+			(unsigned long long)n, (unsigned long long)lost.load(std::memory_order_relaxed), (unsigned long long)out_of_order.load(std::memory_order_relaxed),
+			percentile(0.5), percentile(0.99), (double)max_usec.load(std::memory_order_relaxed) / 1000.0);
+		if (n)
+		{
+			len += sprintf(msg + len, ", stages");
+			for (int i = 0; i < n_stages.load(std::memory_order_relaxed); i++)
+				len += sprintf(msg + len, " %.2f", (double)stage_usec[i].load(std::memory_order_relaxed) / (double)n / 1000.0);
+			sprintf(msg + len, " ms");
+		}
+
+		return std::string(msg);
+	}
+
+public:
+	std::atomic<uint64_t> frames, lost, out_of_order;
+	std::atomic<uint64_t> max_usec;
+	std::atomic<uint64_t> histogram[N_LATENCY_BINS];
+	std::atomic<uint64_t> stage_usec[MAX_FRAME_STAGES]; // summed time spent up to each stage after the previous one
+	std::atomic<int> n_stages;
+
+private:
+	uint64_t next_seq; // sink thread
+	bool started;
+};
+
+#endif // FRAMEDESCRIPTOR_H
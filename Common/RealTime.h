@@ -0,0 +1,220 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define RT_PRIORITY_LOW				-1 // background analysis (SCHED_IDLE / THREAD_PRIORITY_LOWEST)
+#define RT_PRIORITY_NORMAL			0 // default scheduling
+#define RT_PRIORITY_HIGH			1 // processing threads (SCHED_RR / THREAD_PRIORITY_HIGHEST)
+#define RT_PRIORITY_CRITICAL		2 // acquisition threads (SCHED_FIFO / THREAD_PRIORITY_TIME_CRITICAL)
+
+#define RT_WORKING_SET_MARGIN		(64 << 20) // extra working set granted with each grow [byte]
+
+
+// Real-time policy: thread priorities, memory locking & prefaulting of the pipeline buffers.
+// The calls do not throw: failures (e.g. missing CAP_SYS_NICE / RLIMIT_MEMLOCK, working set quota) are counted for report().
+class RealTime
+{
+public:
+	// Priority of a thread started by the caller
+	static bool setPriority(std::thread& thread, int level)
+	{
+		bool ok = applyPriority(thread.native_handle(), level);
+		if (!ok) state().priority_failures++;
+		return ok;
+	}
+
+	// Priority of the calling thread
+	static bool setCurrentPriority(int level)
+	{
+#if defined(_WIN32)
+		bool ok = applyPriority(::GetCurrentThread(), level);
+#else
+		bool ok = applyPriority(pthread_self(), level);
+#endif
+		if (!ok) state().priority_failures++;
+		return ok;
+	}
+
+	// Enable memory locking: the whole process on Linux (mlockall), the buffers passed to prefault() on Windows
+	static bool lockMemory()
+	{
+		State& s = state();
+		s.locking = true;
+#if defined(_WIN32)
+		return true;
+#else
+		s.all_locked = (mlockall(MCL_CURRENT | MCL_FUTURE) == 0);
+		if (!s.all_locked) s.lock_failures++;
+		return s.all_locked;
+#endif
+	}
+
+	// Touch every page of a freshly allocated buffer (no first-pass page faults) and lock it when memory locking is on
+	static bool prefault(void* ptr, size_t bytes)
+	{
+		if (!ptr || !bytes) return true;
+
+		size_t page = pageSize();
+		volatile char* p = static_cast<volatile char*>(ptr);
+		for (size_t i = 0; i < bytes; i += page)
+			p[i] = p[i];
+		p[bytes - 1] = p[bytes - 1];
+
+		State& s = state();
+		if (!s.locking || s.all_locked) return true;
+
+		bool ok = lock(ptr, bytes);
+		if (ok)
+			s.locked_bytes += bytes;
+		else
+			s.lock_failures++;
+		return ok;
+	}
+
+	// Before freeing a buffer passed to prefault()
+	static void release(void* ptr, size_t bytes)
+	{
+		State& s = state();
+		if (!ptr || !bytes || !s.locking || s.all_locked) return;
+#if defined(_WIN32)
+		if (::VirtualUnlock(ptr, bytes))
+#else
+		if (munlock(ptr, bytes) == 0)
+#endif
+			s.locked_bytes -= (std::min)((uint64_t)bytes, s.locked_bytes.load());
+	}
+
+	static std::string report()
+	{
+		State& s = state();
+		char msg[256];
+		int len = sprintf(msg, "[RealTime] memory locking: ");
+		if (!s.locking)
+			len += sprintf(msg + len, "off");
+		else if (s.all_locked)
+			len += sprintf(msg + len, "all pages locked (mlockall)");
+		else
+			len += sprintf(msg + len, "%.1f MB locked", (double)s.locked_bytes.load() / 1024.0 / 1024.0);
+		if (s.lock_failures)
+			len += sprintf(msg + len, ", %d lock failures (working set quota / RLIMIT_MEMLOCK)", s.lock_failures.load());
+		if (s.priority_failures)
+			sprintf(msg + len, ", %d thread priority failures (privileges)", s.priority_failures.load());
+
+		return std::string(msg);
+	}
+
+	static const char* priorityName(int level)
+	{
+		switch (level)
+		{
+		case RT_PRIORITY_LOW: return "low";
+		case RT_PRIORITY_HIGH: return "high";
+		case RT_PRIORITY_CRITICAL: return "critical";
+		default: return "normal";
+		}
+	}
+
+private:
+	struct State
+	{
+		State() : locking(false), all_locked(false), locked_bytes(0), lock_failures(0), priority_failures(0) {}
+
+		std::atomic<bool> locking, all_locked;
+		std::atomic<uint64_t> locked_bytes;
+		std::atomic<int> lock_failures, priority_failures;
+	};
+
+	static State& state()
+	{
+		static State s;
+		return s;
+	}
+
+	static size_t pageSize()
+	{
+#if defined(_WIN32)
+		SYSTEM_INFO info;
+		::GetSystemInfo(&info);
+		return (size_t)info.dwPageSize;
+#else
+		return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+	}
+
+#if defined(_WIN32)
+	static bool applyPriority(HANDLE thread, int level)
+	{
+		int priority = (level == RT_PRIORITY_CRITICAL) ? THREAD_PRIORITY_TIME_CRITICAL :
+			(level == RT_PRIORITY_HIGH) ? THREAD_PRIORITY_HIGHEST : (level == RT_PRIORITY_LOW) ? THREAD_PRIORITY_LOWEST : THREAD_PRIORITY_NORMAL;
+		return ::SetThreadPriority(thread, priority) != 0;
+	}
+
+	// VirtualLock is bounded by the minimum working set: grow it on demand and retry
+	static bool lock(void* ptr, size_t bytes)
+	{
+		if (::VirtualLock(ptr, bytes)) return true;
+		if (::GetLastError() != ERROR_WORKING_SET_QUOTA) return false;
+
+		SIZE_T min_size, max_size;
+		HANDLE process = ::GetCurrentProcess();
+		if (!::GetProcessWorkingSetSize(process, &min_size, &max_size)) return false;
+		if (!::SetProcessWorkingSetSize(process, min_size + bytes + RT_WORKING_SET_MARGIN, max_size + bytes + RT_WORKING_SET_MARGIN)) return false;
+
+		return ::VirtualLock(ptr, bytes) != 0;
+	}
+#else
+	static bool applyPriority(pthread_t thread, int level)
+	{
+		sched_param param;
+		int policy;
+		if (level == RT_PRIORITY_CRITICAL)
+		{
+			policy = SCHED_FIFO;
+			param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 9; // below the kernel's own RT threads
+		}
+		else if (level == RT_PRIORITY_HIGH)
+		{
+			policy = SCHED_RR;
+			param.sched_priority = (sched_get_priority_min(SCHED_RR) + sched_get_priority_max(SCHED_RR)) / 2;
+		}
+#ifdef SCHED_IDLE
+		else if (level == RT_PRIORITY_LOW)
+		{
+			policy = SCHED_IDLE;
+			param.sched_priority = 0;
+		}
+#endif
+		else
+		{
+			policy = SCHED_OTHER;
+			param.sched_priority = 0;
+		}
+		return pthread_setschedparam(thread, policy, &param) == 0;
+	}
+
+	static bool lock(void* ptr, size_t bytes)
+	{
+		return mlock(ptr, bytes) == 0;
+	}
+#endif
+};
+
+#endif // REALTIME_H
@@ -0,0 +1,159 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#define CACHE_LINE_SIZE 64
+#define RING_SPIN_COUNT 1024
+
+// Single-producer / single-consumer ring of preallocated slots.
+// try_push / try_pop are wait-free; pop spins and then parks until an item arrives or the ring is closed.
+// close() may be called from any thread: the consumer drains the pending items and then receives T() (stop sentinel).
+template <typename T>
+class RingBuffer
+{
+public:
+	explicit RingBuffer(size_t _capacity = 0) : head(0), tail(0), mask(0), closed(false), waiting(false)
+	{
+		if (_capacity) reserve(_capacity);
+	}
+
+	~RingBuffer() {}
+
+private: // Not to call copy constrcutor and copy assignment operator
+	RingBuffer(const RingBuffer&);
+	RingBuffer& operator=(const RingBuffer&);
+
+public:
+	// Not thread safe: call before the producer and the consumer are started
+	void reserve(size_t _capacity)
+	{
+		size_t n = 1;
+		while (n < _capacity) n <<= 1;
+
+		slots.assign(n, T());
+		mask = n - 1;
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+		closed.store(false, std::memory_order_relaxed);
+	}
+
+	// Producer
+	bool try_push(const T& item)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) > mask)
+			return false; // full
+
+		slots[t & mask] = item;
+		tail.store(t + 1, std::memory_order_seq_cst);
+
+		// Wake the consumer only if it is parked
+		if (waiting.load(std::memory_order_seq_cst))
+			wake();
+
+		return true;
+	}
+
+	void push(const T& item)
+	{
+		while (!try_push(item))
+			std::this_thread::yield();
+	}
+
+	// Consumer
+	bool try_pop(T& item)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false; // empty
+
+		item = slots[h & mask];
+		head.store(h + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	T pop()
+	{
+		T item;
+		for (int i = 0; i < RING_SPIN_COUNT; i++)
+		{
+			if (try_pop(item))
+				return item;
+			if (closed.load(std::memory_order_acquire))
+				return drain_or_sentinel();
+		}
+
+		// Park
+		while (true)
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			waiting.store(true, std::memory_order_seq_cst);
+			cond.wait(lock, [&]() { return !empty() || closed.load(std::memory_order_seq_cst); });
+			waiting.store(false, std::memory_order_relaxed);
+			lock.unlock();
+
+			if (try_pop(item))
+				return item;
+			if (closed.load(std::memory_order_acquire))
+				return drain_or_sentinel();
+		}
+	}
+
+	// Any thread: stop sentinel
+	void close()
+	{
+		closed.store(true, std::memory_order_seq_cst);
+		wake();
+	}
+
+	// Not thread safe: clear a stop sentinel that was never consumed
+	void reopen()
+	{
+		closed.store(false, std::memory_order_relaxed);
+	}
+
+	bool empty() const { return head.load(std::memory_order_seq_cst) == tail.load(std::memory_order_seq_cst); }
+	size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+	size_t capacity() const { return slots.size(); }
+
+private:
+	// Consumer, after seeing closed: an item pushed before the close may have landed after the last try_pop
+	T drain_or_sentinel()
+	{
+		T item;
+		if (try_pop(item))
+			return item;
+		return take_sentinel();
+	}
+
+	void wake()
+	{
+		{ std::lock_guard<std::mutex> lock(mtx); }
+		cond.notify_one();
+	}
+
+	T take_sentinel()
+	{
+		closed.store(false, std::memory_order_release); // re-armed for the next acquisition
+		return T();
+	}
+
+private:
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> head; // consumer index
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail; // producer index
+	alignas(CACHE_LINE_SIZE) std::vector<T> slots;
+	size_t mask;
+
+	alignas(CACHE_LINE_SIZE) std::atomic<bool> closed;
+	std::atomic<bool> waiting;
+	std::mutex mtx;
+	std::condition_variable cond;
+};
+
+#endif // RINGBUFFER_H
@@ -2,50 +2,234 @@
 #define SYNCOBJECT_H
 
 #include <iostream>
-#include <queue>
-#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
-#include <Common/Queue.h>
+#include <Common/RingBuffer.h>
+#include <Common/FrameDescriptor.h>
+#include <Common/RealTime.h>
+
+#define SYNC_POLICY_DROP_NEWEST		0 // no free buffer: the new item is dropped
+#define SYNC_POLICY_BLOCK			1 // no free buffer: the producer waits (up to block_timeout) before dropping
+
+struct SyncStats
+{
+	uint64_t offered = 0, accepted = 0, dropped = 0;
+	size_t depth = 0, high_water = 0, capacity = 0;
+	double blocked_msec = 0.0; // producer waiting for a free buffer
+	double starved_msec = 0.0; // consumer waiting for a filled buffer
+};
+
+template <typename T>
+struct SyncItem
+{
+	T* buffer = nullptr;
+	uint64_t seq = 0; // sequence number assigned by the producer
+	FrameDescriptor desc; // travels with the buffer
+};
 
 template <typename T>
 class SyncObject
 {
 public:
-    SyncObject() {}
+    SyncObject() : spare_buffer(nullptr), n_buffer(0), buffer_bytes(0), policy(SYNC_POLICY_DROP_NEWEST), block_timeout(std::chrono::milliseconds(100)) { resetStats(); }
     ~SyncObject() {	deallocate_queue_buffer(); }
 
 public:
+    // Buffers are prefaulted (& locked when the real-time memory locking is on) before the streaming starts
     void allocate_queue_buffer(int width, int height, int n)
     {
         n_buffer = n;
+        buffer_bytes = (size_t)width * height * sizeof(T);
+        queue_buffer.reserve(n_buffer);
+        Queue_sync.reserve(n_buffer);
         for (int i = 0; i < n_buffer; i++)
         {
             T* buffer = new T[width * height];
-            memset(buffer, 0, width * height * sizeof(T));
+            memset(buffer, 0, buffer_bytes);
+            RealTime::prefault(buffer, buffer_bytes);
             queue_buffer.push(buffer);
         }
     }
 
     void deallocate_queue_buffer()
     {
-        for (int i = 0; i < n_buffer; i++)
+        if (spare_buffer)
+        {
+            queue_buffer.push(spare_buffer);
+            spare_buffer = nullptr;
+        }
+        T* buffer;
+        while (queue_buffer.try_pop(buffer))
+        {
+            RealTime::release(buffer, buffer_bytes);
+            delete[] buffer;
+        }
+        SyncItem<T> item;
+        while (Queue_sync.try_pop(item))
+        {
+            if (item.buffer && (item.desc.lease < 0)) // lent buffers belong to the producer
+            {
+                RealTime::release(item.buffer, buffer_bytes);
+                delete[] item.buffer;
+            }
+        }
+    }
+
+    // Not thread safe: return the buffers left in flight by the last run and clear the stop sentinel (lent buffers are dropped)
+    void reset()
+    {
+        if (spare_buffer)
+        {
+            queue_buffer.push(spare_buffer);
+            spare_buffer = nullptr;
+        }
+        SyncItem<T> item;
+        while (Queue_sync.try_pop(item))
+            if (item.buffer && (item.desc.lease < 0)) queue_buffer.push(item.buffer);
+        Queue_sync.reopen();
+    }
+
+    // Producer: free buffer for the next item (nullptr: dropped by the policy)
+    T* acquire()
+    {
+        offered.fetch_add(1, std::memory_order_relaxed);
+
+        T* buffer = spare_buffer;
+        spare_buffer = nullptr;
+        if (!buffer && !queue_buffer.try_pop(buffer) && (policy == SYNC_POLICY_BLOCK))
         {
-            if (!queue_buffer.empty())
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now(), t1 = t0;
+            while (!queue_buffer.try_pop(buffer) && (t1 - t0 < block_timeout))
             {
-                T* buffer = queue_buffer.front();
-                queue_buffer.pop();
-                delete[] buffer;
+                std::this_thread::yield();
+                t1 = std::chrono::steady_clock::now();
             }
+            blocked_usec.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count(), std::memory_order_relaxed);
         }
+
+        if (buffer)
+            accepted.fetch_add(1, std::memory_order_relaxed);
+        else
+            dropped.fetch_add(1, std::memory_order_relaxed);
+
+        return buffer;
+    }
+
+    // Producer: hand a buffer owned by the producer (desc->lease) to the consumer, no acquire() (false: queue full)
+    bool lend(T* buffer, uint64_t seq, const FrameDescriptor* desc)
+    {
+        SyncItem<T> item;
+        item.buffer = buffer;
+        item.seq = seq;
+        item.desc = *desc;
+
+        offered.fetch_add(1, std::memory_order_relaxed);
+        if (!Queue_sync.try_push(item))
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        accepted.fetch_add(1, std::memory_order_relaxed);
+
+        size_t depth = Queue_sync.size(), hw = high_water.load(std::memory_order_relaxed);
+        while ((depth > hw) && !high_water.compare_exchange_weak(hw, depth, std::memory_order_relaxed));
+
+        return true;
+    }
+
+    // Producer: hand the filled buffer (and its descriptor) to the consumer
+    void post(T* buffer, uint64_t seq = 0, const FrameDescriptor* desc = nullptr)
+    {
+        SyncItem<T> item;
+        item.buffer = buffer;
+        item.seq = seq;
+        if (desc) item.desc = *desc;
+        Queue_sync.push(item);
+
+        size_t depth = Queue_sync.size(), hw = high_water.load(std::memory_order_relaxed);
+        while ((depth > hw) && !high_water.compare_exchange_weak(hw, depth, std::memory_order_relaxed));
+    }
+
+    // Producer that must not wait (acquisition callback): as post(), but a full queue drops the item
+    // and its buffer is kept for the next acquire() (queue_buffer has a single producer: the consumer) (false: dropped)
+    bool try_post(T* buffer, uint64_t seq = 0, const FrameDescriptor* desc = nullptr)
+    {
+        SyncItem<T> item;
+        item.buffer = buffer;
+        item.seq = seq;
+        if (desc) item.desc = *desc;
+        if (!Queue_sync.try_push(item))
+        {
+            spare_buffer = buffer;
+            accepted.fetch_sub(1, std::memory_order_relaxed);
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        size_t depth = Queue_sync.size(), hw = high_water.load(std::memory_order_relaxed);
+        while ((depth > hw) && !high_water.compare_exchange_weak(hw, depth, std::memory_order_relaxed));
+
+        return true;
+    }
+
+    // Consumer: next filled buffer (nullptr: stop sentinel)
+    T* take(uint64_t* seq = nullptr, FrameDescriptor* desc = nullptr)
+    {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        SyncItem<T> item = Queue_sync.pop();
+        starved_usec.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count(), std::memory_order_relaxed);
+
+        if (seq) *seq = item.seq;
+        if (desc) *desc = item.desc;
+        return item.buffer;
+    }
+
+    // Consumer: return the buffer to the producer
+    void release(T* buffer)
+    {
+        queue_buffer.push(buffer);
+    }
+
+    // Any thread
+    SyncStats stats() const
+    {
+        SyncStats s;
+        s.offered = offered.load(std::memory_order_relaxed);
+        s.accepted = accepted.load(std::memory_order_relaxed);
+        s.dropped = dropped.load(std::memory_order_relaxed);
+        s.depth = Queue_sync.size();
+        s.high_water = high_water.load(std::memory_order_relaxed);
+        s.capacity = (size_t)n_buffer;
+        s.blocked_msec = (double)blocked_usec.load(std::memory_order_relaxed) / 1000.0;
+        s.starved_msec = (double)starved_usec.load(std::memory_order_relaxed) / 1000.0;
+        return s;
+    }
+
+    void resetStats()
+    {
+        offered = 0; accepted = 0; dropped = 0;
+        high_water = 0;
+        blocked_usec = 0; starved_usec = 0;
     }
 
 public:
-    std::queue<T*> queue_buffer; // Buffers for threading operations
-    std::mutex mtx; // Mutex for buffering operation
-    Queue<T*> Queue_sync; // Synchronization objects for threading operations
+    RingBuffer<T*> queue_buffer; // Free buffers for threading operations (returned by the consumer, taken by the producer)
+    RingBuffer<SyncItem<T>> Queue_sync; // Filled buffers for threading operations (nullptr: stop sentinel)
+
+    T* spare_buffer; // producer: buffer of an item dropped by try_post, handed out by the next acquire()
+
+    int policy; // SYNC_POLICY_DROP_NEWEST or SYNC_POLICY_BLOCK
+    std::chrono::milliseconds block_timeout;
 
 private:
     int n_buffer;
+    size_t buffer_bytes;
+
+    std::atomic<uint64_t> offered, accepted, dropped;
+    std::atomic<size_t> high_water;
+    std::atomic<uint64_t> blocked_usec, starved_usec;
 };
 
 #endif // SYNCOBJECT_H
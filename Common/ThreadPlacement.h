@@ -0,0 +1,259 @@
+#ifndef THREADPLACEMENT_H
+#define THREADPLACEMENT_H
+
+#include <string>
+#include <thread>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <Common/RealTime.h>
+
+#include <tbb/task_arena.h>
+#include <tbb/task_scheduler_observer.h>
+
+#define PLACEMENT_DAQ					0 // Alazar / ImagingSource acquisition thread
+#define PLACEMENT_FLIM_PROCESSING		1 // FLIm worker threads & their TBB tasks
+#define PLACEMENT_VISUALIZATION			2 // visualization thread & its TBB tasks
+#define PLACEMENT_WRITER				3 // MemoryBuffer writing thread & its TBB tasks
+#define N_PLACEMENTS					4
+
+#define MAX_PLACEMENT_CPUS				64
+
+
+// CPU set of a pipeline stage: its threads are pinned to the set (with the stage priority), and its TBB work runs in an
+// isolated arena whose workers are pinned to the same set. An empty set without concurrency leaves the stage on the global pool.
+class StagePlacement
+{
+public:
+	StagePlacement() : cpu_mask(0), concurrency(0), numa_node(-1), masters(1), priority(RT_PRIORITY_NORMAL), arena(nullptr), observer(nullptr) {}
+	~StagePlacement() { release(); }
+
+private: // Not to call copy constrcutor and copy assignment operator
+	StagePlacement(const StagePlacement&);
+	StagePlacement& operator=(const StagePlacement&);
+
+public:
+	// cpus: "2-5,8" (empty: any), _concurrency: arena slots (0: one per cpu), _numa_node: -1 (any),
+	// _masters: threads of the stage entering the arena (e.g. FLIm workers), _priority: RT_PRIORITY_* of the stage threads
+	void initialize(const char* _name, const char* cpus, int _concurrency, int _numa_node, int _masters = 1, int _priority = RT_PRIORITY_NORMAL)
+	{
+		release();
+
+		name = _name;
+		cpu_mask = parseCpuList(cpus);
+		numa_node = _numa_node;
+		masters = (std::max)(_masters, 1);
+		priority = _priority;
+
+		if (numa_node >= 0)
+		{
+			uint64_t node_mask = getNumaNodeMask(numa_node);
+			cpu_mask = cpu_mask ? (cpu_mask & node_mask) : node_mask;
+		}
+
+		concurrency = _concurrency;
+		if ((concurrency == 0) && cpu_mask)
+			concurrency = countCpus(cpu_mask);
+		if (concurrency > 0)
+		{
+			concurrency = (std::max)(concurrency, masters);
+			arena = new tbb::task_arena(concurrency, (unsigned)masters);
+			arena->initialize();
+			if (cpu_mask)
+			{
+				observer = new PinObserver(*arena, cpu_mask);
+				observer->observe(true);
+			}
+		}
+	}
+
+	// Pin a thread started by the caller (no arena)
+	bool pin(std::thread& thread) const
+	{
+		if (!cpu_mask) return true;
+#if defined(_WIN32)
+		return ::SetThreadAffinityMask(thread.native_handle(), (DWORD_PTR)cpu_mask) != 0;
+#else
+		return setAffinity(thread.native_handle(), cpu_mask);
+#endif
+	}
+
+	// Calling thread: pin to the cpu set and raise to the stage priority (false: not granted)
+	bool enter() const
+	{
+		bool ok = true;
+		if (cpu_mask)
+		{
+#if defined(_WIN32)
+			ok = ::SetThreadAffinityMask(::GetCurrentThread(), (DWORD_PTR)cpu_mask) != 0;
+#else
+			ok = setAffinity(pthread_self(), cpu_mask);
+#endif
+		}
+		if (priority != RT_PRIORITY_NORMAL)
+			ok = RealTime::setCurrentPriority(priority) && ok;
+
+		return ok;
+	}
+
+	// Execute f inside the stage arena
+	template <typename F>
+	void execute(const F& f)
+	{
+		if (arena)
+			arena->execute(f);
+		else
+			f();
+	}
+
+	// Calling thread: enter the placement and execute f inside the stage arena
+	template <typename F>
+	void run(const F& f)
+	{
+		enter();
+		execute(f);
+	}
+
+	std::string report() const
+	{
+		char msg[256];
+		int len = sprintf(msg, "[Placement] %s: ", name.c_str());
+		if (!cpu_mask)
+			len += sprintf(msg + len, "cpus any");
+		else
+		{
+			len += sprintf(msg + len, "cpus");
+			for (int i = 0; i < MAX_PLACEMENT_CPUS; i++)
+				if (cpu_mask & (1ULL << i))
+					len += sprintf(msg + len, " %d", i);
+		}
+		if (numa_node >= 0)
+			len += sprintf(msg + len, ", NUMA node %d", numa_node);
+		len += sprintf(msg + len, ", %s priority", RealTime::priorityName(priority));
+		if (arena)
+			sprintf(msg + len, ", arena %d slots (%d reserved)", concurrency, masters);
+		else
+			sprintf(msg + len, ", global TBB pool");
+
+		return std::string(msg);
+	}
+
+private:
+	void release()
+	{
+		if (observer) { observer->observe(false); delete observer; observer = nullptr; }
+		if (arena) { delete arena; arena = nullptr; }
+	}
+
+	static uint64_t parseCpuList(const char* cpus)
+	{
+		uint64_t mask = 0;
+		int first = -1, value = -1;
+		for (const char* p = cpus; ; p++)
+		{
+			if ((*p >= '0') && (*p <= '9'))
+				value = ((value < 0) ? 0 : value * 10) + (*p - '0');
+			else if (*p == '-')
+			{
+				first = value;
+				value = -1;
+			}
+			else if ((*p == ',') || (*p == '\0'))
+			{
+				if (value >= 0)
+				{
+					if (first < 0) first = value;
+					for (int i = first; (i <= value) && (i < MAX_PLACEMENT_CPUS); i++)
+						mask |= (1ULL << i);
+				}
+				first = -1; value = -1;
+				if (*p == '\0') break;
+			}
+		}
+		return mask;
+	}
+
+	static int countCpus(uint64_t mask)
+	{
+		int n = 0;
+		for (; mask; mask &= mask - 1) n++;
+		return n;
+	}
+
+	static uint64_t getNumaNodeMask(int node)
+	{
+#if defined(_WIN32)
+		ULONGLONG mask = 0;
+		if (!::GetNumaNodeProcessorMask((UCHAR)node, &mask))
+			return 0;
+		return (uint64_t)mask;
+#else
+		char path[128], cpus[1024] = { 0, };
+		sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+		FILE* fp = fopen(path, "r");
+		if (!fp) return 0;
+		if (!fgets(cpus, sizeof(cpus), fp)) cpus[0] = '\0';
+		fclose(fp);
+		for (char* p = cpus; *p; p++)
+			if (*p == '\n') *p = '\0';
+		return parseCpuList(cpus);
+#endif
+	}
+
+#if !defined(_WIN32)
+	static bool setAffinity(pthread_t thread, uint64_t mask)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int i = 0; i < MAX_PLACEMENT_CPUS; i++)
+			if (mask & (1ULL << i))
+				CPU_SET(i, &set);
+		return pthread_setaffinity_np(thread, sizeof(cpu_set_t), &set) == 0;
+	}
+#endif
+
+	// Pins the TBB workers joining the stage arena
+	class PinObserver : public tbb::task_scheduler_observer
+	{
+	public:
+		PinObserver(tbb::task_arena& _arena, uint64_t _mask) : tbb::task_scheduler_observer(_arena), mask(_mask) {}
+
+		void on_scheduler_entry(bool is_worker)
+		{
+			if (!is_worker) return; // the stage threads are pinned in run()
+#if defined(_WIN32)
+			::SetThreadAffinityMask(::GetCurrentThread(), (DWORD_PTR)mask);
+#else
+			setAffinity(pthread_self(), mask);
+#endif
+		}
+
+	private:
+		uint64_t mask;
+	};
+
+public:
+	std::string name;
+	uint64_t cpu_mask;
+	int concurrency;
+	int numa_node;
+	int masters;
+	int priority;
+
+private:
+	tbb::task_arena* arena;
+	PinObserver* observer;
+};
+
+#endif // THREADPLACEMENT_H
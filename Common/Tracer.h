@@ -0,0 +1,184 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#define TRACE_BUFFER_SIZE		65536 // events per thread (power of 2, the oldest are overwritten)
+
+#define TRACE_CONCAT_(a, b)		a##b
+#define TRACE_CONCAT(a, b)		TRACE_CONCAT_(a, b)
+
+// Scoped span (name: string literal or a string outliving the dump) & thread name for the trace viewer
+#define TRACE_SCOPE(name)		TraceSpan TRACE_CONCAT(_trace_span_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name)	Tracer::setThreadName(name)
+
+
+struct TraceEvent
+{
+	const char* name;
+	uint64_t begin, end; // TSC
+};
+
+// Events of one thread: written by its owner only, read by dump() after the tracing is stopped
+struct TraceBuffer
+{
+	TraceBuffer(int _tid) : tid(_tid), head(0), events(TRACE_BUFFER_SIZE) {}
+
+	inline void push(const char* name, uint64_t begin, uint64_t end)
+	{
+		uint64_t h = head.load(std::memory_order_relaxed);
+		TraceEvent& e = events[h & (TRACE_BUFFER_SIZE - 1)];
+		e.name = name; e.begin = begin; e.end = end;
+		head.store(h + 1, std::memory_order_release);
+	}
+
+	int tid;
+	std::string name;
+	std::atomic<uint64_t> head;
+	std::vector<TraceEvent> events;
+};
+
+// Per-thread lock-free span recorder with Chrome / Perfetto JSON export (chrome://tracing, ui.perfetto.dev).
+// Disabled: one relaxed atomic load per span. Enabled: two rdtsc & one buffer write per span.
+class Tracer
+{
+public:
+	static inline bool enabled() { return instance().on.load(std::memory_order_relaxed); }
+	static inline uint64_t now() { return __rdtsc(); }
+
+	static void start()
+	{
+		Tracer& t = instance();
+		t.tsc0 = now();
+		t.t0 = std::chrono::steady_clock::now();
+		t.on.store(true, std::memory_order_release);
+	}
+
+	static void stop()
+	{
+		Tracer& t = instance();
+		t.on.store(false, std::memory_order_release);
+		t.tsc1 = now();
+		t.t1 = std::chrono::steady_clock::now();
+	}
+
+	// Allocated at the first span of the thread (tracing enabled only) and kept until exit: dumps may follow the thread
+	static inline TraceBuffer* buffer()
+	{
+		TraceBuffer*& _buffer = threadBuffer();
+		if (!_buffer)
+		{
+			Tracer& t = instance();
+			std::lock_guard<std::mutex> lock(t.mtx);
+			_buffer = new TraceBuffer((int)t.buffers.size() + 1);
+			_buffer->name = threadName();
+			t.buffers.push_back(_buffer);
+		}
+		return _buffer;
+	}
+
+	static void setThreadName(const char* name)
+	{
+		std::lock_guard<std::mutex> lock(instance().mtx);
+		threadName() = name;
+		if (threadBuffer())
+			threadBuffer()->name = name;
+	}
+
+	// Write the spans of the last start() ~ stop() interval (call after stop())
+	static bool dump(const char* path)
+	{
+		Tracer& t = instance();
+		FILE* fp = fopen(path, "w");
+		if (!fp) return false;
+
+		double usec = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t.t1 - t.t0).count() / 1000.0;
+		double tick_usec = (t.tsc1 > t.tsc0) ? usec / (double)(t.tsc1 - t.tsc0) : 0.0;
+
+		std::lock_guard<std::mutex> lock(t.mtx);
+		fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		bool first = true;
+		for (TraceBuffer* b : t.buffers)
+		{
+			if (!b->name.empty())
+			{
+				fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", b->tid, b->name.c_str());
+				first = false;
+			}
+
+			uint64_t h = b->head.load(std::memory_order_acquire);
+			uint64_t n = (h < TRACE_BUFFER_SIZE) ? h : TRACE_BUFFER_SIZE;
+			for (uint64_t i = h - n; i < h; i++)
+			{
+				const TraceEvent& e = b->events[i & (TRACE_BUFFER_SIZE - 1)];
+				if ((e.begin < t.tsc0) || (e.end > t.tsc1)) continue;
+
+				fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",\n",
+					e.name, b->tid, (double)(e.begin - t.tsc0) * tick_usec, (double)(e.end - e.begin) * tick_usec);
+				first = false;
+			}
+		}
+		fprintf(fp, "\n]}\n");
+		fclose(fp);
+
+		return true;
+	}
+
+private:
+	Tracer() : on(false), tsc0(0), tsc1(0) {}
+
+	static Tracer& instance()
+	{
+		static Tracer tracer;
+		return tracer;
+	}
+
+	static TraceBuffer*& threadBuffer()
+	{
+		static thread_local TraceBuffer* _buffer = nullptr;
+		return _buffer;
+	}
+
+	static std::string& threadName()
+	{
+		static thread_local std::string _name;
+		return _name;
+	}
+
+private:
+	std::atomic<bool> on;
+	uint64_t tsc0, tsc1;
+	std::chrono::steady_clock::time_point t0, t1;
+
+	std::mutex mtx;
+	std::vector<TraceBuffer*> buffers;
+};
+
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char* _name) : name(_name), begin(Tracer::enabled() ? Tracer::now() : 0) {}
+	~TraceSpan()
+	{
+		if (begin)
+			Tracer::buffer()->push(name, begin, Tracer::now());
+	}
+
+private:
+	const char* name;
+	uint64_t begin;
+};
+
+#endif // TRACER_H
@@ -2,6 +2,23 @@
 #define NUMCPP_ALLOCATOR_H_
 
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <new>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+#define POOL_MIN_BLOCK			64 // smallest size class [byte]
+#define POOL_MAX_BLOCK			(64 << 20) // larger blocks bypass the pool [byte]
+#define POOL_CACHE_BYTES		(64 << 20) // free bytes kept per size class (at least 2 blocks)
+#define POOL_CLASSES_PER_OCTAVE	4 // size classes: 2^e * (1 + k / 4), k = 1..4 (< 25% waste)
+#define POOL_CONTROL_ALIGNMENT	64 // shared_ptr control blocks: cache line, whatever the alignment of the payload
 
 namespace np {
 
@@ -18,6 +35,179 @@ struct heap_allocator
 	}
 };
 
+// Size-class pools of aligned blocks: freed blocks are kept for the next allocation of the same class,
+// so arrays re-created every frame stop hitting the heap once the streaming loop is warmed up.
+template <size_t Alignment>
+class aligned_pool
+{
+public:
+	static aligned_pool &instance()
+	{
+		static aligned_pool *pool = new aligned_pool; // never destroyed: arrays may outlive static objects
+		return *pool;
+	}
+
+	void *acquire(size_t size)
+	{
+		int index = class_index(size);
+		if (index < 0)
+		{
+			misses.fetch_add(1, std::memory_order_relaxed);
+			return allocate_block(size);
+		}
+
+		SizeClass &c = classes[index];
+		{
+			std::lock_guard<std::mutex> lock(c.mtx);
+			if (!c.blocks.empty())
+			{
+				void *ptr = c.blocks.back();
+				c.blocks.pop_back();
+				hits.fetch_add(1, std::memory_order_relaxed);
+				cached_bytes.fetch_sub(class_size(index), std::memory_order_relaxed);
+				return ptr;
+			}
+		}
+
+		misses.fetch_add(1, std::memory_order_relaxed);
+		return allocate_block(class_size(index));
+	}
+
+	void release(void *ptr, size_t size)
+	{
+		int index = class_index(size);
+		if (index >= 0)
+		{
+			size_t bytes = class_size(index);
+			size_t max_blocks = (std::max)((size_t)2, (size_t)POOL_CACHE_BYTES / bytes);
+
+			SizeClass &c = classes[index];
+			std::lock_guard<std::mutex> lock(c.mtx);
+			if (c.blocks.size() < max_blocks)
+			{
+				if (c.blocks.capacity() < max_blocks)
+					c.blocks.reserve(max_blocks);
+				c.blocks.push_back(ptr);
+				cached_bytes.fetch_add(bytes, std::memory_order_relaxed);
+				return;
+			}
+		}
+
+		free_block(ptr);
+	}
+
+	// Release the cached blocks to the system
+	void trim()
+	{
+		for (int i = 0; i < N_CLASSES; i++)
+		{
+			std::lock_guard<std::mutex> lock(classes[i].mtx);
+			for (void *ptr : classes[i].blocks)
+				free_block(ptr);
+			cached_bytes.fetch_sub(classes[i].blocks.size() * class_size(i), std::memory_order_relaxed);
+			classes[i].blocks.clear();
+		}
+	}
+
+public:
+	static int class_index(size_t size)
+	{
+		if (size > POOL_MAX_BLOCK) return -1;
+		if (size <= POOL_MIN_BLOCK) return 0;
+
+		int e = 0; // 2^e < size <= 2^(e+1)
+		while (((size_t)2 << e) < size) e++;
+		size_t step = ((size_t)1 << e) / POOL_CLASSES_PER_OCTAVE;
+		int k = (int)((size - ((size_t)1 << e) + step - 1) / step); // 1..4
+
+		return (e - LOG2_MIN_BLOCK) * POOL_CLASSES_PER_OCTAVE + k;
+	}
+
+	static size_t class_size(int index)
+	{
+		if (index == 0) return POOL_MIN_BLOCK;
+
+		int e = (index - 1) / POOL_CLASSES_PER_OCTAVE + LOG2_MIN_BLOCK;
+		int k = (index - 1) % POOL_CLASSES_PER_OCTAVE + 1;
+		return ((size_t)1 << e) + (size_t)k * (((size_t)1 << e) / POOL_CLASSES_PER_OCTAVE);
+	}
+
+private:
+	aligned_pool() : hits(0), misses(0), cached_bytes(0) {}
+
+	static void *allocate_block(size_t size)
+	{
+#if defined(_MSC_VER)
+		void *ptr = _aligned_malloc(size, Alignment);
+#else
+		void *ptr = nullptr;
+		if (posix_memalign(&ptr, Alignment, size) != 0) ptr = nullptr;
+#endif
+		if (!ptr) throw std::bad_alloc();
+		return ptr;
+	}
+
+	static void free_block(void *ptr)
+	{
+#if defined(_MSC_VER)
+		_aligned_free(ptr);
+#else
+		::free(ptr);
+#endif
+	}
+
+private:
+	enum { LOG2_MIN_BLOCK = 6, N_CLASSES = (26 - LOG2_MIN_BLOCK) * POOL_CLASSES_PER_OCTAVE + 1 }; // up to POOL_MAX_BLOCK (2^26)
+
+	struct SizeClass
+	{
+		std::mutex mtx;
+		std::vector<void *> blocks;
+	};
+	SizeClass classes[N_CLASSES];
+
+public:
+	std::atomic<uint64_t> hits, misses; // acquisitions served from / past the pool
+	std::atomic<size_t> cached_bytes;
+};
+
+// Array allocator: aligned blocks recycled through aligned_pool, including the shared_ptr control block
+// (kept out of band in the cache line pool: only the payload takes the page / huge page alignment)
+template <size_t Alignment>
+struct aligned_pool_allocator
+{
+	struct deleter
+	{
+		size_t size;
+		void operator()(void *ptr) const { aligned_pool<Alignment>::instance().release(ptr, size); }
+	};
+
+	template <typename U>
+	struct control_allocator
+	{
+		typedef U value_type;
+
+		control_allocator() {}
+		template <typename V> control_allocator(const control_allocator<V> &) {}
+
+		U *allocate(size_t n) { return static_cast<U *>(aligned_pool<POOL_CONTROL_ALIGNMENT>::instance().acquire(n * sizeof(U))); }
+		void deallocate(U *ptr, size_t n) { aligned_pool<POOL_CONTROL_ALIGNMENT>::instance().release(ptr, n * sizeof(U)); }
+
+		template <typename V> bool operator==(const control_allocator<V> &) const { return true; }
+		template <typename V> bool operator!=(const control_allocator<V> &) const { return false; }
+	};
+
+	static std::shared_ptr<void> allocate(int size)
+	{
+		deleter d = { (size_t)size };
+		return std::shared_ptr<void>(aligned_pool<Alignment>::instance().acquire((size_t)size), d, control_allocator<char>());
+	}
+};
+
+typedef aligned_pool_allocator<64> pool_allocator; // cache line (AVX-512 loads)
+typedef aligned_pool_allocator<4096> page_allocator;
+typedef aligned_pool_allocator<(2 << 20)> huge_page_allocator; // 2 MB boundary (large page candidates)
+
 } // namespace np
 
 #endif // NUMCPP_ALLOCATOR_H_
@@ -94,7 +94,7 @@ namespace np {
 
 
 
-	template <typename T, size_t Dim = 1, class Allocator = heap_allocator>
+	template <typename T, size_t Dim = 1, class Allocator = pool_allocator>
 	struct Array
 
 	{
@@ -367,6 +367,92 @@ namespace np {
 		return result;
 	}
 
+	// Non-owning (strided) view: no reference count, for sub-arrays of pooled buffers & arrays in the hot paths.
+	// The viewed memory must outlive the view.
+	template <typename T, size_t Dim = 1>
+	struct View
+	{
+	public:
+		typedef T value_type;
+		typedef std::array<int, Dim> size_type;
+		typedef std::array<int, Dim> stride_type;
+
+		int _length;
+		size_type _size;
+		stride_type _stride;
+		value_type *_origin;
+
+	public:
+		View() :
+			_length(0),
+			_size(zero_array<Dim>()),
+			_stride(make_stride(zero_array<Dim>())),
+			_origin(nullptr)
+		{
+		}
+
+		View(value_type *ptr, int size0) :
+			_length(size0),
+			_size(make_array(size0)),
+			_stride(make_stride<1>(make_array(size0))),
+			_origin(ptr)
+		{
+			static_assert(Dim == 1, "This function is only for View<T, 1>");
+		}
+
+		// stride1: elements between two columns (0: size0, contiguous)
+		View(value_type *ptr, int size0, int size1, int stride1 = 0) :
+			_length(size0 * size1),
+			_size(make_array(size0, size1)),
+			_stride(make_array(1, stride1 ? stride1 : size0)),
+			_origin(ptr)
+		{
+			static_assert(Dim == 2, "This function is only for View<T, 2>");
+		}
+
+		template <class Allocator>
+		View(Array<T, Dim, Allocator> &array) :
+			_length(array.length()),
+			_size(array.size()),
+			_stride(array.strides()),
+			_origin(array.raw_ptr())
+		{
+		}
+
+		int length() const { return _length; }
+		int ndims() const { return Dim; }
+		const size_type &size() const { return _size; }
+		int size(int dim) const { return _size[dim]; }
+		const stride_type &strides() const { return _stride; }
+		int stride(int dim) const { return _stride[dim]; }
+		bool contiguous() const { return (Dim == 1) ? (_stride[0] == 1) : (_stride[Dim - 1] == _size[Dim - 2] * _stride[Dim - 2]); }
+
+		value_type *raw_ptr() const { return _origin; }
+		operator value_type *() const { return _origin; }
+
+		// Accessing elements
+
+		T &at(int index0) const { return _origin[index0 * _stride[0]]; }
+		T &operator()(int index0) const { return at(index0); }
+		T &operator[](int index0) const { return at(index0); }
+
+		T &at(int index0, int index1) const
+		{
+			static_assert(Dim >= 2, "View dimension bounds error");
+			return _origin[index0 * _stride[0] + index1 * _stride[1]];
+		}
+		T &operator()(int index0, int index1) const { return at(index0, index1); }
+
+		// Column index1 of a 2D view
+		View<T, 1> column(int index1) const
+		{
+			static_assert(Dim == 2, "This function is only for View<T, 2>");
+			View<T, 1> result(_origin + index1 * _stride[1], _size[0]);
+			result._stride = make_array(_stride[0]);
+			return result;
+		}
+	};
+
 	using Uint8Array		 = Array<uint8_t>;
 	using Uint8Array2		 = Array<uint8_t, 2>;
 
@@ -382,6 +468,12 @@ namespace np {
 	using ComplexFloatArray  = Array<std::complex<float>>;
     using ComplexFloatArray2 = Array<std::complex<float>, 2>;
 
+	using Uint16View		 = View<uint16_t>;
+	using Uint16View2		 = View<uint16_t, 2>;
+
+	using FloatView			 = View<float>;
+	using FloatView2		 = View<float, 2>;
+
 } // namespace np
 
 #endif // NUMCPP_ARRAY_H_
@@ -1,16 +1,29 @@
 
 #include "AlazarDAQ.h"
 
+#include <Common/ThreadPlacement.h>
+#include <Common/RealTime.h>
+#include <Common/Tracer.h>
+
+#include <algorithm>
+
 
 using namespace std;
 
 AlazarDAQ::AlazarDAQ() :
     SystemId(1), nChannels(1), nScans(1000), nAlines(1024),
+    bufferCount(BUFFER_COUNT), recordsPerBuffer(1024),
     VoltRange1(INPUT_RANGE_PM_400_MV), VoltRange2(INPUT_RANGE_PM_400_MV),
     AcqRate(SAMPLE_RATE_1000MSPS), TriggerDelay(0), TriggerSlope(TRIGGER_SLOPE_POSITIVE),
     UseExternalClock(false), UseAutoTrigger(false), frameRate(0.0),
-    _dirty(true), _running(false), boardHandle(nullptr)
+    _dirty(true), _running(false), placement(nullptr), boardHandle(nullptr),
+    _current(-1), _generation(0), _lent(0), _starved(0)
 {
+	for (int slot = 0; slot < MAX_BUFFER_SLOTS; slot++)
+	{
+		_holders[slot] = 0;
+		_orphans[slot] = nullptr;
+	}
 }
 
 AlazarDAQ::~AlazarDAQ()
@@ -23,6 +36,11 @@ AlazarDAQ::~AlazarDAQ()
 
     // Abort the acquisition
     abort_acq();
+
+	// Buffers never released by the stages
+	for (int slot = 0; slot < MAX_BUFFER_SLOTS; slot++)
+		if (_orphans[slot])
+			AlazarFreeBufferU16(boardHandle, _orphans[slot]);
 }
 
 
@@ -238,13 +256,107 @@ void AlazarDAQ::abort_acq()
 	retCode = AlazarAbortAsyncRead(boardHandle);
 
 	// Free all memory allocated
-	for (U32 bufferIndex = 0; bufferIndex < BUFFER_COUNT; bufferIndex++)
+	// Buffers still lent downstream are orphaned instead: freed by their last release, their slots skipped meanwhile
+	int orphaned = 0;
+	for (size_t bufferIndex = 0; bufferIndex < BufferArray.size(); bufferIndex++)
 	{
 		if (BufferArray[bufferIndex] != NULL)
-			AlazarFreeBufferU16(boardHandle, BufferArray[bufferIndex]);
+		{
+			int slot = _slot[bufferIndex];
+			_orphans[slot] = BufferArray[bufferIndex];
+
+			uint32_t word = _holders[slot].load(std::memory_order_acquire);
+			while ((word & HOLDER_COUNT_MASK) && !_holders[slot].compare_exchange_weak(word, word | HOLDER_ORPHANED, std::memory_order_acq_rel, std::memory_order_acquire));
+
+			if (word & HOLDER_COUNT_MASK)
+				orphaned++;
+			else
+			{
+				_orphans[slot] = nullptr;
+				AlazarFreeBufferU16(boardHandle, BufferArray[bufferIndex]);
+			}
+		}
+	}
+	BufferArray.clear();
+	_slot.clear();
+	_onBoard.clear();
+	_posted.clear();
+
+	if (orphaned)
+	{
+		char msg[MAX_MSG_LENGTH];
+		sprintf(msg, "[AlazarDAQ] WARNING: %d DMA buffers still lent at the end of the acquisition (freed on their release).", orphaned);
+		SendStatusMessage(msg, false);
+	}
+}
+
+int AlazarDAQ::lend()
+{
+	// Keep a few buffers on the board: past that point the data is copied and the buffer reposted at once
+	if ((_current < 0) || ((int)_posted.size() < MIN_POSTED_BUFFERS))
+		return -1;
+
+	int slot = _slot[_current];
+	_holders[slot].fetch_add(1, std::memory_order_relaxed);
+	_lent.fetch_add(1, std::memory_order_relaxed);
+
+	return (_generation.load(std::memory_order_relaxed) << LEASE_INDEX_BITS) | slot;
+}
+
+void AlazarDAQ::release(int lease)
+{
+	if (lease < 0)
+		return;
+
+	int slot = lease & ((1 << LEASE_INDEX_BITS) - 1);
+	uint32_t generation = (uint32_t)lease >> LEASE_INDEX_BITS;
+	if (slot >= MAX_BUFFER_SLOTS)
+		return;
+
+	// Generation check & decrement in one step: a stale lease never touches a slot taken by a later acquisition
+	uint32_t word = _holders[slot].load(std::memory_order_acquire);
+	do
+	{
+		if (((word >> LEASE_INDEX_BITS) != generation) || !(word & HOLDER_COUNT_MASK))
+			return;
+	} while (!_holders[slot].compare_exchange_weak(word, word - 1, std::memory_order_acq_rel, std::memory_order_acquire));
+
+	if (!(word & HOLDER_ORPHANED))
+		_lent.fetch_sub(1, std::memory_order_relaxed);
+	else if ((word & HOLDER_COUNT_MASK) == 1)
+	{
+		// Last lease of a buffer orphaned by the end of its acquisition: freed, the slot is free again
+		AlazarFreeBufferU16(boardHandle, _orphans[slot]);
+		_orphans[slot] = nullptr;
+		_holders[slot].store(generation << LEASE_INDEX_BITS, std::memory_order_release);
 	}
 }
 
+// Post the buffers released by the callbacks & the downstream stages back to the board (acquisition thread)
+void AlazarDAQ::repost(U32 bytesPerBuffer)
+{
+	for (int bufferIndex = 0; bufferIndex < (int)BufferArray.size(); bufferIndex++)
+	{
+		if (_onBoard[bufferIndex] || (_holders[_slot[bufferIndex]].load(std::memory_order_acquire) & HOLDER_COUNT_MASK))
+			continue;
+
+		RETURN_CODE retCode = AlazarPostAsyncBuffer(boardHandle, BufferArray[bufferIndex], bytesPerBuffer);
+		if (retCode == ApiSuccess)
+		{
+			_onBoard[bufferIndex] = true;
+			_posted.push_back(bufferIndex);
+		}
+	}
+}
+
+// The stages drain their queues after the stop sentinel: wait for the leases before freeing the buffers
+void AlazarDAQ::waitLent()
+{
+	DWORD dwTickStart = GetTickCount();
+	while (_lent.load() && (GetTickCount() - dwTickStart < LEND_TIMEOUT_MS))
+		SwitchToThread();
+}
+
 bool AlazarDAQ::startAcquisition()
 {
     if (_thread.joinable())
@@ -254,11 +366,10 @@ bool AlazarDAQ::startAcquisition()
     }
 
     _thread = std::thread(&AlazarDAQ::run, this); // thread executing
-    if (::SetThreadPriority(_thread.native_handle(), THREAD_PRIORITY_TIME_CRITICAL) == 0)
-    {
-        dumpErrorSystem(::GetLastError(), "[AlazarDAQ] ERROR: Failed to set acquisition thread priority: ");
-        return false;
-    }
+    if (!RealTime::setPriority(_thread, placement ? placement->priority : RT_PRIORITY_CRITICAL))
+        SendStatusMessage("[AlazarDAQ] WARNING: Failed to set real-time acquisition thread priority (privileges).", false);
+    if (placement && !placement->pin(_thread))
+        SendStatusMessage("[AlazarDAQ] WARNING: Failed to set acquisition thread affinity.", false);
 
 	SendStatusMessage("Data acquisition thread is started.", false);
 
@@ -288,8 +399,9 @@ void AlazarDAQ::run()
     // Select the number of post-trigger samples per record
     U32 postTriggerSamples = nScans - preTriggerSamples;
 
-    // Specify the number of records per DMA buffer
-    U32 recordsPerBuffer = nAlines;
+    // Specify the number of records per DMA buffer (whole pieces of nAlines records)
+    int piecesPerBuffer = (std::max)(this->recordsPerBuffer / nAlines, 1);
+    U32 recordsPerBuffer = piecesPerBuffer * nAlines;
 
     // MEMO: we always acquire two channel and if nChannels == 1, interlace and send only 1 channel
 
@@ -314,12 +426,37 @@ void AlazarDAQ::run()
     U32 samplesPerRecord = preTriggerSamples + postTriggerSamples; // nScans
     U32 bytesPerRecord = bytesPerSample * samplesPerRecord; // size_of(UINT16) * nScans
     U32 bytesPerBuffer = bytesPerRecord * recordsPerBuffer * channelCount; // 2 * sizeof(UINT16) * nScans
+    size_t samplesPerPiece = (size_t)channelCount * nScans * nAlines;
 
     BOOL success = TRUE;
 
-    // Allocate memory for DMA buffers
-    U32 bufferIndex;
-    for (bufferIndex = 0; (bufferIndex < BUFFER_COUNT) && success; bufferIndex++)
+    // Allocate memory for DMA buffers (new generation of leases, on the slots not held by orphaned buffers)
+    int nBuffers = (std::min)((std::max)(bufferCount, MIN_POSTED_BUFFERS + 1), MAX_BUFFER_SLOTS);
+    uint32_t generation = (uint32_t)((_generation.load() + 1) & ((1 << (31 - LEASE_INDEX_BITS)) - 1));
+    _generation.store((int)generation);
+    _slot.clear();
+    for (int slot = 0; (slot < MAX_BUFFER_SLOTS) && ((int)_slot.size() < nBuffers); slot++)
+    {
+        if (_holders[slot].load(std::memory_order_acquire) & (HOLDER_ORPHANED | HOLDER_COUNT_MASK))
+            continue;
+        _holders[slot].store(generation << LEASE_INDEX_BITS, std::memory_order_release);
+        _slot.push_back(slot);
+    }
+    if ((int)_slot.size() < MIN_POSTED_BUFFERS + 1)
+    {
+        SendStatusMessage("[AlazarDAQ] ERROR: DMA buffer slots still held by the stages.", true);
+        return;
+    }
+    nBuffers = (int)_slot.size();
+    _lent = 0;
+    _starved = 0;
+    _current = -1;
+    BufferArray.assign(nBuffers, nullptr);
+    _onBoard.assign(nBuffers, false);
+    _posted.clear();
+
+    int bufferIndex;
+    for (bufferIndex = 0; (bufferIndex < nBuffers) && success; bufferIndex++)
     {
 		//BufferArray[bufferIndex] = (U16*)VirtualAlloc(NULL, bytesPerBuffer, MEM_COMMIT, PAGE_READWRITE);
         
@@ -389,7 +526,7 @@ void AlazarDAQ::run()
     }
 
     // Add the buffers to a list of buffers available to be filled by the board
-    for (bufferIndex = 0; (bufferIndex < BUFFER_COUNT) && success; bufferIndex++)
+    for (bufferIndex = 0; (bufferIndex < nBuffers) && success; bufferIndex++)
     {
         U16* pBuffer = BufferArray[bufferIndex];
         retCode = AlazarPostAsyncBuffer(boardHandle, pBuffer, bytesPerBuffer);
@@ -398,6 +535,11 @@ void AlazarDAQ::run()
             dumpError(retCode, "[AlazarDAQ] ERROR: AlazarPostAsyncBuffer failed 1: ");
             success = FALSE;
         }
+        else
+        {
+            _onBoard[bufferIndex] = true;
+            _posted.push_back(bufferIndex);
+        }
     }
 
     // Arm the board system to wait for a trigger event to begin the acquisition
@@ -414,7 +556,7 @@ void AlazarDAQ::run()
     // Wait for each buffer to be filled, process the buffer, and re-post it to the board.
     if (success)
     {
-        U32 buffersCompleted = 0, buffersCompletedUpdate = 0;
+        U32 piecesCompleted = 0, piecesCompletedUpdate = 0;
         UINT64 bytesTransferred = 0, bytesTransferredPerUpdate = 0;
         ULONG dwTickStart = 0, dwTickLastUpdate;
 
@@ -422,12 +564,26 @@ void AlazarDAQ::run()
         // required to capture all the records in one buffer.
         DWORD timeout_ms = 50;
 
+        TRACE_THREAD_NAME("AlazarDAQ");
+
         _running = true;
         while (_running)
         {
+            // Every buffer lent downstream: nothing to wait on until the stages release one
+            if (_posted.empty())
+            {
+                _starved++;
+                while (_running && _posted.empty())
+                {
+                    SwitchToThread();
+                    repost(bytesPerBuffer);
+                }
+                continue;
+            }
+
             // Wait for the buffer at the head of the list of available buffers
             // to be filled by the board.
-            bufferIndex = buffersCompleted % BUFFER_COUNT;
+            bufferIndex = _posted.front();
             U16* pBuffer = BufferArray[bufferIndex];
 			
             while (true)
@@ -458,7 +614,9 @@ void AlazarDAQ::run()
             {
                 // The buffer is full and has been removed from the list
                 // of buffers available for the board        
-                buffersCompletedUpdate++;
+                _posted.pop_front();
+                _onBoard[bufferIndex] = false;
+                piecesCompletedUpdate += piecesPerBuffer;
                 bytesTransferred += bytesPerBuffer;
                 bytesTransferredPerUpdate += bytesPerBuffer;
 
@@ -472,6 +630,8 @@ void AlazarDAQ::run()
                 // You MUST finish processing this buffer and post it back to the
                 // board before the board fills all of its available DMA buffers
                 // and on-board memory.
+                // => The callbacks may lend() the buffer instead: it is reposted when
+                //    the last lease is released, the rest of the pool keeps the board fed.
                 //
                 // Records are arranged in the buffer as follows:
                 // R0[AB], R1[AB], R2[AB] ... Rn[AB]
@@ -487,11 +647,18 @@ void AlazarDAQ::run()
 
                 //if (nChannels == 2)
                 {
-					// Callback                    
-					np::Array<uint16_t, 2> frame(pBuffer, channelCount * nScans, nAlines);
-
-					// MEMO: -1 to make buffersCompleted start with 0 (same as signatec system)                    
-					DidAcquireData(buffersCompleted++, frame);				
+					// Callbacks (one per piece of nAlines records): the acquisition thread holds the buffer meanwhile
+					_holders[_slot[bufferIndex]].fetch_add(1, std::memory_order_relaxed);
+					_current = bufferIndex;
+					for (int piece = 0; piece < piecesPerBuffer; piece++)
+					{
+						TRACE_SCOPE("DAQ callback");
+
+						// MEMO: piecesCompleted starts with 0 (same as signatec system)
+						DidAcquireData(piecesCompleted++, pBuffer + piece * samplesPerPiece);
+					}
+					_current = -1;
+					_holders[_slot[bufferIndex]].fetch_sub(1, std::memory_order_release);
                 }
 //                else if (nChannels == 1)
 //                {
@@ -513,16 +680,9 @@ void AlazarDAQ::run()
 //                }
             }
 				
-            // Add the buffer to the end of the list of available buffers.
+            // Add the buffer (unless lent) and the released ones to the end of the list of available buffers.
             if (success)
-            {
-                retCode = AlazarPostAsyncBuffer(boardHandle, pBuffer, bytesPerBuffer);
-                if (retCode != ApiSuccess)
-                {
-                    //dumpError(retCode, "[AlazarDAQ] ERROR: AlazarPostAsyncBuffer failed 2: ");
-                    //success = FALSE;
-                }
-            }
+                repost(bytesPerBuffer);
 
             // If the acquisition failed, exit the acquisition loop
             if (!success)
@@ -547,7 +707,7 @@ void AlazarDAQ::run()
                 {
                     dRate = (bytesTransferred / 1000000.0) / (dwElapsed / 1000.0);
                     dRateUpdate = (bytesTransferredPerUpdate / 1000000.0) / (dwElapsedUpdate / 1000.0);
-					frameRate = (double)buffersCompletedUpdate / (double)(dwElapsedUpdate) * 1000.0;
+					frameRate = (double)piecesCompletedUpdate / (double)(dwElapsedUpdate) * 1000.0;
 
                     unsigned h = 0, m = 0, s = 0;
                     if (dwElapsed >= 1000)
@@ -564,16 +724,18 @@ void AlazarDAQ::run()
                     }
 
 					char msg[MAX_MSG_LENGTH];
-					sprintf(msg, "[AlazarDAQ] [SystemId: %d] [Elapsed Time] %u:%02u:%02u [DAQ Rate] %4.2f MB/s [Frame Rate] %3.2f fps ", 
-						SystemId, h, m, s, dRateUpdate, frameRate);
+					sprintf(msg, "[AlazarDAQ] [SystemId: %d] [Elapsed Time] %u:%02u:%02u [DAQ Rate] %4.2f MB/s [Frame Rate] %3.2f fps [DMA] %d/%d lent, %d starved ", 
+						SystemId, h, m, s, dRateUpdate, frameRate, _lent.load(), (int)BufferArray.size(), _starved);
 					SendStatusMessage(msg, false);
                 }
 
                 // reset
-                buffersCompletedUpdate = 0;
+                piecesCompletedUpdate = 0;
                 bytesTransferredPerUpdate = 0;
             }
         }
+
+        waitLent();
     }
 
     // Abort the acquisition
@@ -9,12 +9,23 @@
 #include <Common/callback.h>
 
 #include <iostream>
-#include <array>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
 #include <thread>
 
-#define BUFFER_COUNT 4
+#define BUFFER_COUNT 16 // DMA buffers (default)
+#define MIN_POSTED_BUFFERS 2 // buffers always left to the board: no lending below
+#define MAX_BUFFER_SLOTS 256 // holder slots: DMA buffers of the acquisition & buffers still lent by earlier ones
+#define LEASE_INDEX_BITS 16 // lease: acquisition generation << 16 | slot (holder word: generation << 16 | orphaned | holders)
+#define HOLDER_COUNT_MASK 0x7FFF
+#define HOLDER_ORPHANED 0x8000 // lent at the end of its acquisition: freed by the last release
+#define LEND_TIMEOUT_MS 1000 // wait for the lent buffers at the end of the acquisition
 #define MAX_MSG_LENGTH 2000
 
+class StagePlacement;
+
 
 ///typedef enum RETURN_CODE RETURN_CODE;
 ///typedef void * HANDLE;
@@ -34,12 +45,19 @@ public:
 
     bool startAcquisition();
     void stopAcquisition();
+
+	// DMA buffer lending (in-place processing): called inside DidAcquireData, keeps the buffer of the callback
+	// off the board until every lease is released (any thread). -1: not lent (pool headroom exhausted), copy the data.
+	int lend();
+	void release(int lease);
 	
 public:
 	inline bool is_initialized() const { return !_dirty; }
 
 private:
 	void run();
+	void repost(U32 bytesPerBuffer);
+	void waitLent();
 
 private:
 	// Dump an error
@@ -52,7 +70,17 @@ private:
 	HANDLE boardHandle;
 
 	// Array of buffer pointers
-    std::array<uint16_t *, BUFFER_COUNT> BufferArray;
+    std::vector<uint16_t *> BufferArray;
+
+	// Buffer pool state
+	std::atomic<uint32_t> _holders[MAX_BUFFER_SLOTS]; // per slot: generation, orphaned flag & holders (acquisition thread & leases, 0: free to post)
+	U16* _orphans[MAX_BUFFER_SLOTS]; // per slot: buffer of an aborted acquisition until its last release
+	std::vector<int> _slot; // acquisition thread: holder slot of each buffer
+	std::vector<bool> _onBoard; // acquisition thread
+	std::deque<int> _posted; // acquisition thread: buffers on the board in posting order
+	int _current; // buffer of the running callbacks (-1: none)
+	std::atomic<int> _generation, _lent;
+	int _starved; // waits with every buffer lent
 	
 	// Initialization flag
 	bool _dirty;
@@ -63,6 +91,8 @@ private:
 public:
 	unsigned long SystemId;
     int nChannels, nScans, nAlines;
+	int bufferCount; // DMA buffers in the pool (on the board or lent downstream)
+	int recordsPerBuffer; // records per DMA buffer: multiple of nAlines (one DidAcquireData per nAlines records)
 	unsigned long VoltRange1, VoltRange2;
 	unsigned long AcqRate;
 	unsigned long TriggerDelay;
@@ -71,6 +101,8 @@ public:
     bool UseAutoTrigger;
 	double frameRate;
 	bool _running;
+
+	StagePlacement* placement; // cpu set of the acquisition thread (nullptr: any)
 	
 public:
 	// callbacks	
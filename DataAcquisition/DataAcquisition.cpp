@@ -6,6 +6,9 @@
 #include <DataAcquisition/QpiProcess/QpiProcess.h>
 #include <DataAcquisition/ImagingSource/ImagingSource.h>
 
+#include <Common/ThreadPlacement.h>
+#include <Common/RealTime.h>
+
 #include <QImage>
 
 
@@ -14,32 +17,66 @@ DataAcquisition::DataAcquisition(Configuration* pConfig)
 {
     m_pConfig = pConfig;
 
+	// Lock the pipeline buffers in memory (before they are allocated)
+	if (m_pConfig->memoryLocking && !RealTime::lockMemory())
+		m_pConfig->msgHandle("[RealTime] WARNING: Failed to lock the process memory (mlockall: CAP_IPC_LOCK / RLIMIT_MEMLOCK); buffers are locked one by one.");
+
+	// Create thread placement objects (cpu sets, priorities & isolated TBB arenas of the pipeline stages)
+	const char* stage_name[N_PLACEMENTS] = { "DAQ", "FLIm processing", "Visualization", "Writer" };
+	for (int i = 0; i < N_PLACEMENTS; i++)
+	{
+		StagePlacement* pPlacement = new StagePlacement;
+		pPlacement->initialize(stage_name[i], m_pConfig->placementCpus[i].toUtf8().constData(),
+			m_pConfig->placementConcurrency[i], m_pConfig->placementNumaNode[i], (i == PLACEMENT_FLIM_PROCESSING) ? m_pConfig->flimWorkers : 1,
+			m_pConfig->placementPriority[i]);
+		m_pConfig->msgHandle(pPlacement->report().c_str());
+		m_vecPlacement.push_back(pPlacement);
+	}
+
     // Create SignatecDAQ object
     m_pDaq = new AlazarDAQ;
     m_pDaq->DidStopData += [&]() { m_pDaq->_running = false; };
+	m_pDaq->placement = m_vecPlacement.at(PLACEMENT_DAQ);
 
     // Create FLIm process object
     m_pFLIm = new FLImProcess;
 	m_pFLIm->SendStatusMessage += [&](const char* msg) { m_pConfig->msgHandle(msg); };
 	m_pFLIm->_resize.SendStatusMessage += [&](const char* msg) { m_pConfig->msgHandle(msg); };
     m_pFLIm->setParameters(m_pConfig);
-    m_pFLIm->_resize(np::FloatArray2(m_pConfig->nScans, m_pConfig->nTimes), m_pFLIm->_params);
+    m_pFLIm->_resize(np::Uint16Array2(m_pConfig->nScans, m_pConfig->nTimes), m_pFLIm->_params);
+	if (m_pConfig->flimSplineBenchmark)
+		m_pFLIm->_resize.benchmark();
     m_pFLIm->loadMaskData();
 
+	// Create FLIm worker objects (the master is worker 0; the others follow its parameters)
+	m_vecFLImWorkers.push_back(m_pFLIm);
+	for (int i = 1; i < m_pConfig->flimWorkers; i++)
+	{
+		FLImProcess* pFLIm = new FLImProcess;
+		pFLIm->SendStatusMessage += [&](const char* msg) { m_pConfig->msgHandle(msg); };
+		pFLIm->setParameters(m_pConfig);
+		pFLIm->_resize(np::Uint16Array2(m_pConfig->nScans, m_pConfig->nTimes), pFLIm->_params);
+		m_vecFLImWorkers.push_back(pFLIm);
+	}
+
 	// Create QPI process object
 	m_pQpi = new QpiProcess(CMOS_WIDTH, CMOS_HEIGHT, PUPIL_RADIUS, m_pConfig->regL2amp, m_pConfig->regL2phase, m_pConfig->regTv);
 	
 	// Create Brightfield camera object
 	m_pImagingSource = new ImagingSource;
 	m_pImagingSource->DidStopData += [&]() { m_pImagingSource->_running = false; };
+	m_pImagingSource->placement = m_vecPlacement.at(PLACEMENT_DAQ);
 }
 
 DataAcquisition::~DataAcquisition()
 {
     if (m_pDaq) delete m_pDaq;
+    for (int i = 1; i < (int)m_vecFLImWorkers.size(); i++)
+        delete m_vecFLImWorkers.at(i);
     if (m_pFLIm) delete m_pFLIm;
 	if (m_pQpi) delete m_pQpi;
 	if (m_pImagingSource) delete m_pImagingSource;
+	for (StagePlacement* pPlacement : m_vecPlacement) delete pPlacement;
 }
 
 
@@ -49,10 +86,18 @@ bool DataAcquisition::InitializeAcquistion(bool is_flim)
 	{
 		// Parameter settings for DAQ & Axsun Capture
 		m_pDaq->SystemId = 1;
-		m_pDaq->AcqRate = SAMPLE_RATE_500MSPS;
+		switch (m_pConfig->adcRate)
+		{
+		case 125: m_pDaq->AcqRate = SAMPLE_RATE_125MSPS; break;
+		case 250: m_pDaq->AcqRate = SAMPLE_RATE_250MSPS; break;
+		case 1000: m_pDaq->AcqRate = SAMPLE_RATE_1000MSPS; break;
+		default: m_pDaq->AcqRate = SAMPLE_RATE_500MSPS; break;
+		}
 		m_pDaq->nChannels = 1;
 		m_pDaq->nScans = m_pConfig->nScans;
 		m_pDaq->nAlines = m_pConfig->nTimes;
+		m_pDaq->bufferCount = m_pConfig->dmaBufferCount;
+		m_pDaq->recordsPerBuffer = m_pConfig->dmaPiecesPerBuffer * m_pConfig->nTimes;
 		m_pDaq->TriggerDelay = 0; // trigger delay
 		m_pDaq->VoltRange1 = INPUT_RANGE_PM_400_MV; // INPUT_RANGE_PM_400_MV INPUT_RANGE_PM_1_V INPUT_RANGE_PM_2_V
 
@@ -112,6 +157,17 @@ void DataAcquisition::StopAcquisition(bool is_flim)
 }
 
 
+int DataAcquisition::LendDaqBuffer()
+{
+	return m_pDaq->lend();
+}
+
+void DataAcquisition::ReleaseDaqBuffer(int lease)
+{
+	m_pDaq->release(lease);
+}
+
+
 void DataAcquisition::ConnectDaqAcquiredFlimData(const std::function<void(int, const void*)> &slot)
 {
     m_pDaq->DidAcquireData += slot;
@@ -3,6 +3,8 @@
 
 #include <QObject>
 
+#include <vector>
+
 #include <Doulos/Configuration.h>
 
 #include <Common/array.h>
@@ -12,6 +14,7 @@ class AlazarDAQ;
 class FLImProcess;
 class QpiProcess;
 class ImagingSource;
+class StagePlacement;
 
 
 class DataAcquisition : public QObject
@@ -24,13 +27,20 @@ public:
 
 public:
     inline FLImProcess* getFLIm() const { return m_pFLIm; }
+	inline FLImProcess* getFLImWorker(int i) const { return m_vecFLImWorkers.at(i); }
+	inline int getFLImWorkers() const { return (int)m_vecFLImWorkers.size(); }
 	inline QpiProcess* getQpi() const { return m_pQpi; }
 	inline ImagingSource* getImagingSource() const { return m_pImagingSource; }
+	inline StagePlacement* getPlacement(int stage) const { return m_vecPlacement.at(stage); }
 
 public:
     bool InitializeAcquistion(bool is_flim = true);
     bool StartAcquisition(bool is_flim = true);
     void StopAcquisition(bool is_flim = true);
+
+	// In-place processing of the digitizer DMA buffers: lend inside the acquired-data callback (-1: copy), release from any thread
+	int LendDaqBuffer();
+	void ReleaseDaqBuffer(int lease);
 		
 public:
 	void ConnectDaqAcquiredFlimData(const std::function<void(int, const void*)> &slot);
@@ -45,8 +55,11 @@ private:
 
 	AlazarDAQ* m_pDaq;
     FLImProcess* m_pFLIm;
+	std::vector<FLImProcess*> m_vecFLImWorkers; // [0]: m_pFLIm (master)
 	QpiProcess* m_pQpi;
 	ImagingSource* m_pImagingSource;
+
+	std::vector<StagePlacement*> m_vecPlacement; // PLACEMENT_DAQ, _FLIM_PROCESSING, _VISUALIZATION, _WRITER
 };
 
 #endif // DATAACQUISITION_H
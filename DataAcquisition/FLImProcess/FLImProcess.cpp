@@ -11,28 +11,79 @@ FLImProcess::~FLImProcess()
 }
 
 
-void FLImProcess::operator() (FloatArray2& intensity, FloatArray2& mean_delay, FloatArray2& lifetime, FloatArray2& pulse)
+void FLImProcess::operator() (FloatArray2& intensity, FloatArray2& mean_delay, FloatArray2& lifetime, Uint16Array2& pulse)
 {
-    // 1. Crop and resize pulse data
+    // 1. Ingest raw records (crop, saturation, auto background level)
     _resize(pulse, _params);
 
-    // 2. Get intensity
-    _intensity(_resize);
-    memcpy(intensity, _intensity.intensity, sizeof(float) * _intensity.intensity.length());
+    // 2. Fused per-line processing (BG subtraction, spline, intensity)
+    int nx = (int)_resize.nx, ny = (int)_resize.ny;
+    int n_tiles = (ny + SPLINE_LANES - 1) / SPLINE_LANES;
 
-    // 3. Get lifetime
-    _lifetime(_resize, _params, intensity);
-    memcpy(mean_delay, _lifetime.mean_delay, sizeof(float) * _lifetime.mean_delay.length());
-    memcpy(lifetime, _lifetime.lifetime, sizeof(float) * _lifetime.lifetime.length());
+    if (_params.method == FLIM_METHOD_PHASOR)
+        _phasor.initialize(_params, ny);
+
+    tbb::parallel_for(tbb::blocked_range<int>(0, n_tiles),
+        [&](const tbb::blocked_range<int>& r) {
+        std::vector<float> yt(nx * SPLINE_LANES), mt(nx * SPLINE_LANES);
+
+        for (int t = r.begin(); t != r.end(); ++t)
+        {
+            int line0 = t * SPLINE_LANES;
+            int n_lines = (std::min)(SPLINE_LANES, ny - line0);
+
+            _resize(_params, line0, n_lines, yt.data(), mt.data());
+
+            if (_params.method == FLIM_METHOD_PHASOR)
+            {
+                _phasor(_resize, _params, line0, n_lines, intensity, mean_delay, lifetime);
+                continue;
+            }
+
+            for (int i = line0; i < line0 + n_lines; i++)
+            {
+                double* p0 = &_resize.sint0(0, i);
+                double* p1 = &_resize.sint1(0, i);
+                if (_params.method == FLIM_METHOD_ANALYTIC)
+                    _resize._spline.integrate(_resize.scoeff + i * (nx - 1) * 4, p0, p1);
+
+                _intensity(_resize, _params, i, p0, p1, intensity);
+            }
+        }
+    });
+
+    // 3. Mean delay & lifetime of the A-lines above the intensity threshold
+    if (_params.method == FLIM_METHOD_PHASOR)
+        _phasor.accumulate(_params, intensity);
+    else
+        _lifetime(_resize, _params, intensity, mean_delay, lifetime);
+
+    // 4. Keep a copy of the latest results for the calibration view (only while it is open)
+    if (_lifetime.keep_latest)
+    {
+        if (_lifetime.mean_delay.length() != mean_delay.length())
+            _lifetime.mean_delay = std::move(FloatArray2(mean_delay.size(0), mean_delay.size(1)));
+        if (_lifetime.lifetime.length() != lifetime.length())
+            _lifetime.lifetime = std::move(FloatArray2(lifetime.size(0), lifetime.size(1)));
+        memcpy(_lifetime.mean_delay, mean_delay, sizeof(float) * mean_delay.length());
+        memcpy(_lifetime.lifetime, lifetime, sizeof(float) * lifetime.length());
+    }
 }
 
 
 void FLImProcess::setParameters(Configuration* pConfig)
 {
+    _params.method = pConfig->flimMethod;
+    _params.binning = pConfig->flimBinning;
     _params.bg = pConfig->flimBg;
 
-    _params.samp_intv = 1000.0f / (float)ADC_RATE;
+    _params.samp_intv = 1000.0f / (float)pConfig->adcRate;
     _params.width_factor = 2.0f;
+    _params.intensity_thres = pConfig->flimIntensityThres;
+
+    _params.spline_factor = pConfig->flimSplineFactor;
+    _params.filter_width = pConfig->flimFilterWidth;
+    _params.filter_std = pConfig->flimFilterStd;
 
     for (int i = 0; i < 4; i++)
     {
@@ -40,7 +91,121 @@ void FLImProcess::setParameters(Configuration* pConfig)
         if (i != 0)
              _params.delay_offset[i - 1] = pConfig->flimDelayOffset[i - 1];
     }
-    _params.ch_start_ind[4] = _params.ch_start_ind[3] + FLIM_CH_START_5;
+    _params.ch_start_ind[4] = _params.ch_start_ind[3] + pConfig->flimChEndOffset;
+    _params.ch_end_offset = pConfig->flimChEndOffset;
+
+    publishParameters();
+}
+
+void FLImProcess::publishParameters()
+{
+    std::unique_lock<std::mutex> lock(_params_mutex);
+    _params_published = _params;
+    _materialize_published = _resize.materialize;
+    _params_version.fetch_add(1, std::memory_order_release);
+}
+
+void FLImProcess::syncParameters(const FLImProcess& master)
+{
+    uint32_t version = master._params_version.load(std::memory_order_acquire);
+    if (version == _params_synced)
+        return;
+
+    FLIM_PARAMS params;
+    {
+        std::unique_lock<std::mutex> lock(master._params_mutex);
+        params = master._params_published;
+        _resize.materialize = master._materialize_published;
+        _params_synced = master._params_version.load(std::memory_order_relaxed);
+    }
+
+    // Re-initialize the resize objects only when the parameters were changed (e.g. by the calibration dialog)
+    if (memcmp(&_params, &params, sizeof(FLIM_PARAMS)))
+    {
+        _params = params;
+        _resize.initiated = false;
+    }
+}
+
+void FLImProcess::reportIterations()
+{
+    std::array<int, 11> total = {};
+    _lifetime.iterations.combine_each([&](const std::array<int, 11>& count) {
+        for (int i = 0; i < 11; i++)
+            total[i] += count[i];
+    });
+    _lifetime.iterations.clear();
+
+    int n_total = 0;
+    for (int i = 0; i < 11; i++)
+        n_total += total[i];
+    if (n_total == 0)
+        return;
+
+    char msg[256];
+    int len = sprintf(msg, "Mean delay iterations:");
+    for (int i = 0; i < 11; i++)
+        if (total[i])
+            len += sprintf(msg + len, " [%d] %.1f%%", i, 100.0 * (double)total[i] / (double)n_total);
+    SendStatusMessage(msg);
+}
+
+void FLImProcess::mergePhasorHistogram(FLImProcess& master, int n_workers)
+{
+    std::unique_lock<std::mutex> lock(master._phasor_mutex);
+
+    // Add the histograms of this worker (then cleared for the next acquisition)
+    for (int j = 0; j < 3; j++)
+    {
+        const Uint32Array2& src = _phasor.histogram[j];
+        if (!src.length())
+            continue;
+
+        Uint32Array2& dst = master._phasor_histogram[j];
+        if (dst.length() != src.length())
+        {
+            dst = std::move(Uint32Array2(PHASOR_HIST_BINS, PHASOR_HIST_BINS));
+            memset(dst, 0, sizeof(uint32_t) * dst.length());
+        }
+        for (int k = 0; k < dst.length(); k++)
+            dst.raw_ptr()[k] += src.raw_ptr()[k];
+    }
+    _phasor.clearHistogram();
+
+    if (++master._phasor_merges < n_workers)
+        return;
+    master._phasor_merges = 0;
+
+    // Merged histograms: samples & peak of the first harmonic phasor (g: 0 ~ 1, s: 0 ~ 0.5) per channel
+    char msg[256];
+    int len = sprintf(msg, "Phasor histogram:");
+    bool any = false;
+    for (int j = 0; j < 3; j++)
+    {
+        const Uint32Array2& hist = master._phasor_histogram[j];
+        if (!hist.length())
+            continue;
+
+        uint64_t n = 0; int peak = 0;
+        for (int k = 0; k < hist.length(); k++)
+        {
+            n += hist.raw_ptr()[k];
+            if (hist.raw_ptr()[k] > hist.raw_ptr()[peak])
+                peak = k;
+        }
+        if (n == 0)
+            continue;
+
+        float g = ((float)(peak % PHASOR_HIST_BINS) + 0.5f) / PHASOR_HIST_BINS;
+        float s = ((float)(peak / PHASOR_HIST_BINS) + 0.5f) / (2 * PHASOR_HIST_BINS);
+        len += sprintf(msg + len, " [ch%d] %llu, peak (%.3f, %.3f)", j + 1, (unsigned long long)n, g, s);
+        any = true;
+
+        // Reported: start over at the next acquisition
+        memset(master._phasor_histogram[j], 0, sizeof(uint32_t) * hist.length());
+    }
+    if (any)
+        master.SendStatusMessage(msg);
 }
 
 void FLImProcess::saveMaskData(QString maskpath)
@@ -3,26 +3,16 @@
 
 #include <Doulos/Configuration.h>
 
-#ifndef FLIM_CH_START_5
-#error("FLIM_CH_START_5 is not defined for FLIM processing.");
-#endif
-#ifndef GAUSSIAN_FILTER_WIDTH
-#error("GAUSSIAN_FILTER_WIDTH is not defined for FLIM processing.");
-#endif
-#ifndef GAUSSIAN_FILTER_STD
-#error("GAUSSIAN_FILTER_STD is not defined for FLIM processing.");
-#endif
-#ifndef FLIM_SPLINE_FACTOR
-#error("FLIM_SPLINE_FACTOR is not defined for FLIM processing.");
-#endif
-#ifndef INTENSITY_THRES
-#error("INTENSITY_THRES is not defined for FLIM processing.");
-#endif
-
 #include <iostream>
 #include <vector>
+#include <array>
+#include <complex>
 #include <utility>
 #include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
 
 #include <QString>
 #include <QFile>
@@ -32,6 +22,7 @@
 
 #include <tbb/parallel_for.h>
 #include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
 
 #include <mkl_df.h>
 
@@ -42,12 +33,21 @@ using namespace np;
 
 struct FLIM_PARAMS
 {
+	int method = FLIM_METHOD_UPSAMPLED;
+	int binning = 1; // A-lines summed into one pulse
+
 	float bg;
 
 	float samp_intv = 1.0f;
 	float width_factor = 2.0f;
+	float intensity_thres = INTENSITY_THRES;
+
+	int spline_factor = FLIM_SPLINE_FACTOR;
+	int filter_width = GAUSSIAN_FILTER_WIDTH;
+	float filter_std = GAUSSIAN_FILTER_STD;
 
 	int ch_start_ind[5] = { 0, };
+	int ch_end_offset = FLIM_CH_START_5; // ch_start_ind[4] - ch_start_ind[3]
 	float delay_offset[3] = { 0.0f, };
 };
 
@@ -70,7 +70,7 @@ struct FILTER // Gaussian Filtering
 		ippsFIRSR_32f(pSrc, pDst, srcWidth, pSpec, NULL, NULL, &pBuf[srcWidth * y]);
 	}
 
-	void initialize(int _tapsLen, int _srcWidth, int ny)
+	void initialize(int _tapsLen, float _std, int _srcWidth, int ny)
 	{
 		tapsLen = _tapsLen;
 		srcWidth = _srcWidth;
@@ -80,7 +80,7 @@ struct FILTER // Gaussian Filtering
 		float x;
 		for (int i = 0; i < tapsLen; i++)
 		{
-			x = ((float)i - ((float)tapsLen - 1) / 2) / (float)GAUSSIAN_FILTER_STD;
+			x = ((float)i - ((float)tapsLen - 1) / 2) / _std;
 			pTaps[i] = std::exp(-0.5f * x * x);
 		}
 		float sum; ippsSum_32f(pTaps, tapsLen, &sum, ippAlgHintFast);
@@ -103,89 +103,363 @@ private:
 	Ipp32f* pTaps;
 };
 
+#define SPLINE_LANES 16
+#define SPLINE_BENCHMARK_TOLERANCE 1e-4f // batched engine vs MKL: deviation relative to the peak
+
+struct SPLINE // Cubic spline (not-a-knot) up-sampling on a uniform partition, batched over A-lines
+{
+public:
+	SPLINE() : nx(0), nsite(0)
+	{
+	}
+
+	~SPLINE()
+	{
+	}
+
+	// dst: nsite x n_lines (nullptr to build the coefficients only), src: nx x n_lines, coeff: (nx - 1) x 4 x n_lines
+	void operator() (float* dst, int dst_stride, const float* src, int src_stride, float* coeff, int n_lines)
+	{
+		int n_tiles = (n_lines + SPLINE_LANES - 1) / SPLINE_LANES;
+
+		tbb::parallel_for(tbb::blocked_range<int>(0, n_tiles),
+			[&](const tbb::blocked_range<int>& r) {
+			std::vector<float> yt(nx * SPLINE_LANES), mt(nx * SPLINE_LANES);
+			for (int t = r.begin(); t != r.end(); ++t)
+			{
+				int line0 = t * SPLINE_LANES;
+				int n_lanes = (std::min)(SPLINE_LANES, n_lines - line0);
+				block(dst ? dst + line0 * dst_stride : nullptr, dst_stride, src + line0 * src_stride, src_stride,
+					coeff + line0 * (nx - 1) * 4, n_lanes, yt.data(), mt.data());
+			}
+		});
+	}
+
+	// Running integrals of s(u) and u * s(u) at the knots of one line (p0, p1: nx)
+	void integrate(const float* coeff, double* p0, double* p1) const
+	{
+		p0[0] = 0.0; p1[0] = 0.0;
+		for (int j = 0; j < nx - 1; j++)
+		{
+			const float* c = coeff + 4 * j;
+			double i0 = c[0] + c[1] / 2.0 + c[2] / 3.0 + c[3] / 4.0;
+			double i1 = c[0] / 2.0 + c[1] / 3.0 + c[2] / 4.0 + c[3] / 5.0;
+			p0[j + 1] = p0[j] + i0;
+			p1[j + 1] = p1[j] + (double)j * i0 + i1;
+		}
+	}
+
+	// Integrals of s(u) and u * s(u) over [0, u]
+	void integral(const float* coeff, const double* p0, const double* p1, double u, double& f0, double& f1) const
+	{
+		u = (std::min)((std::max)(u, 0.0), (double)(nx - 1));
+		int j = (std::min)((int)u, nx - 2);
+		double d = u - (double)j;
+
+		const float* c = coeff + 4 * j;
+		double g0 = d * (c[0] + d * (c[1] / 2.0 + d * (c[2] / 3.0 + d * c[3] / 4.0)));
+		double g1 = d * d * (c[0] / 2.0 + d * (c[1] / 3.0 + d * (c[2] / 4.0 + d * c[3] / 5.0)));
+
+		f0 = p0[j] + g0;
+		f1 = p1[j] + (double)j * g0 + g1;
+	}
+
+	void initialize(int _nx, int _nsite)
+	{
+		nx = _nx; nsite = _nsite;
+
+		/* Forward elimination weights of the (1, 4, 1) system of the interior knots */
+		int m = (std::max)(nx - 4, 0);
+		weight.resize(m);
+		double w = 0.0;
+		for (int q = 0; q < m; q++)
+		{
+			w = 1.0 / (4.0 - w);
+			weight[q] = (float)w;
+		}
+
+		/* Interval index and local abscissa of each evaluation site */
+		site_ind.resize(nsite);
+		site_pos.resize(nsite);
+		double step = (double)(nx - 1) / (double)(nsite - 1);
+		for (int k = 0; k < nsite; k++)
+		{
+			double t = (double)k * step;
+			int j = (std::min)((int)t, nx - 2);
+			site_ind[k] = j;
+			site_pos[k] = (float)(t - (double)j);
+		}
+	}
+
+	// One line at the up-sampled sites (interval index & local abscissa from the site tables)
+	static void evaluate_line(float* y, const float* c, const int* ind, const float* pos, int nsite)
+	{
+		for (int k = 0; k < nsite; k++)
+		{
+			const float* cj = c + 4 * ind[k];
+			float d = pos[k];
+			y[k] = cj[0] + d * (cj[1] + d * (cj[2] + d * cj[3]));
+		}
+	}
+
+	// One tile of up to SPLINE_LANES lines (yt, mt: nx x SPLINE_LANES scratch)
+	void block(float* dst, int dst_stride, const float* src, int src_stride, float* coeff, int n_lanes, float* yt, float* mt)
+	{
+		const int L = SPLINE_LANES;
+
+		// 1. Transpose the tile so that every recurrence runs across the lanes
+		for (int l = 0; l < n_lanes; l++)
+			for (int k = 0; k < nx; k++)
+				yt[k * L + l] = src[l * src_stride + k];
+		for (int l = n_lanes; l < L; l++)
+			for (int k = 0; k < nx; k++)
+				yt[k * L + l] = 0.0f;
+
+		// 2. Second derivatives (h = 1): not-a-knot fixes M[1] and M[nx - 2] directly
+		for (int k = 1; k < nx - 1; k++)
+			for (int l = 0; l < L; l++)
+				mt[k * L + l] = 6.0f * (yt[(k - 1) * L + l] - 2.0f * yt[k * L + l] + yt[(k + 1) * L + l]);
+		for (int l = 0; l < L; l++)
+		{
+			mt[1 * L + l] /= 6.0f;
+			mt[(nx - 2) * L + l] /= 6.0f;
+		}
+
+		int m = nx - 4;
+		if (m > 0)
+		{
+			for (int l = 0; l < L; l++)
+			{
+				mt[2 * L + l] -= mt[1 * L + l];
+				mt[(nx - 3) * L + l] -= mt[(nx - 2) * L + l];
+			}
+
+			// Forward elimination
+			for (int l = 0; l < L; l++)
+				mt[2 * L + l] *= weight[0];
+			for (int q = 1; q < m; q++)
+				for (int l = 0; l < L; l++)
+					mt[(q + 2) * L + l] = (mt[(q + 2) * L + l] - mt[(q + 1) * L + l]) * weight[q];
+
+			// Back substitution
+			for (int q = m - 2; q >= 0; q--)
+				for (int l = 0; l < L; l++)
+					mt[(q + 2) * L + l] -= weight[q] * mt[(q + 3) * L + l];
+		}
+
+		for (int l = 0; l < L; l++)
+		{
+			mt[l] = 2.0f * mt[1 * L + l] - mt[2 * L + l];
+			mt[(nx - 1) * L + l] = 2.0f * mt[(nx - 2) * L + l] - mt[(nx - 3) * L + l];
+		}
+
+		// 3. Piecewise polynomial coefficients (same layout as MKL DF_PP_CUBIC)
+		for (int l = 0; l < n_lanes; l++)
+		{
+			float* c = coeff + l * (nx - 1) * 4;
+			for (int j = 0; j < nx - 1; j++)
+			{
+				float y0 = yt[j * L + l], y1 = yt[(j + 1) * L + l];
+				float m0 = mt[j * L + l], m1 = mt[(j + 1) * L + l];
+				c[4 * j + 0] = y0;
+				c[4 * j + 1] = (y1 - y0) - (2.0f * m0 + m1) / 6.0f;
+				c[4 * j + 2] = 0.5f * m0;
+				c[4 * j + 3] = (m1 - m0) / 6.0f;
+			}
+		}
+
+		// 4. Evaluation at the up-sampled sites
+		if (dst)
+		{
+			const int* ind = site_ind.data();
+			const float* pos = site_pos.data();
+			for (int l = 0; l < n_lanes; l++)
+				evaluate_line(dst + l * dst_stride, coeff + l * (nx - 1) * 4, ind, pos, nsite);
+		}
+	}
+
+public:
+	int nx, nsite;
+
+private:
+	std::vector<float> weight;
+	std::vector<int> site_ind;
+	std::vector<float> site_pos;
+};
+
 struct RESIZE
 {
 public:
-	RESIZE() : scoeff(nullptr), pSeq(nullptr), nx(-1), initiated(false)
+	typedef uint8_t(*INGEST)(float*, const uint16_t*, int, const int*, int);
+
+	RESIZE() : scoeff(nullptr), nx(-1), ny(-1), upSampleFactor(0), initiated(false), materialize(false), ingest(ingest_line<1, 1>)
 	{
 	}
 
 	~RESIZE()
 	{
 		if (scoeff) delete[] scoeff;
-		if (pSeq) ippsFree(pSeq);
 	}
 
-	void operator() (const FloatArray2 &src, const FLIM_PARAMS &pParams)
+	void operator() (const Uint16Array2 &src, const FLIM_PARAMS &pParams)
 	{
 		// 0. Initialize
 		int _nx = pParams.ch_start_ind[4] - pParams.ch_start_ind[0];
-		if ((nx != _nx) || !initiated)
-			initialize(pParams, _nx, FLIM_SPLINE_FACTOR, src.size(1));
+		int binning = pParams.binning;
+		if ((nx != _nx) || (ny != src.size(1) / binning) || (upSampleFactor != pParams.spline_factor) || !initiated)
+			initialize(pParams, _nx, pParams.spline_factor, src.size(1) / binning);
 
-		// 1. Crop ROI		
-		double bg_auto;
+		// 1. Ingest: each record is read once for the cropped ROI, the saturation flags and the background tail
+		//    (binning: neighboring records are summed into one line)
 		int offset = pParams.ch_start_ind[0];
-		ippiMean_32f_C1R(&src(offset + crop_src.size(0), 0), sizeof(float) * src.size(0), { src.size(0) - offset - crop_src.size(0), src.size(1) }, &bg_auto, ippAlgHintFast);
-
-		ippiCopy_32f_C1R(&src(offset, 0), sizeof(float) * src.size(0), crop_src.raw_ptr(), sizeof(float) * crop_src.size(0), srcSize);
-		
-		// 2. Determine whether saturated
-		ippsThreshold_32f(crop_src.raw_ptr(), sat_src.raw_ptr(), sat_src.length(), 65531, ippCmpLess);
-		ippsSubC_32f_I(65531, sat_src.raw_ptr(), sat_src.length());
-		int roi_len = (int)round(pulse_roi_length / ActualFactor);
+		int tail = src.size(0) - offset - (int)nx;
+
+		int window[4];
 		for (int i = 0; i < 4; i++)
-		{
-			for (int j = 0; j < ny; j++)
+			window[i] = pParams.ch_start_ind[i] - offset;
+
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, (size_t)ny),
+			[&](const tbb::blocked_range<size_t>& r) {
+			static thread_local std::vector<float> scratch;
+			if ((int)scratch.size() < nx)
+				scratch.resize(nx);
+
+			for (size_t j = r.begin(); j != r.end(); ++j)
 			{
-				saturated(i, j) = 0;
-				offset = pParams.ch_start_ind[i] - pParams.ch_start_ind[0];
-				ippsSum_32f(&sat_src(offset, j), roi_len, &saturated(i, j), ippAlgHintFast);
+				uint8_t mask = 0;
+				uint32_t sum = 0;
+
+				for (int b = 0; b < binning; b++)
+				{
+					const uint16_t* record = &src(offset, (int)j * binning + b);
+
+					// Crop ROI (u16 -> 32f) & saturation flags
+					if (b == 0)
+						mask |= ingest(&crop_src(0, (int)j), record, (int)nx, window, roi_len);
+					else
+					{
+						mask |= ingest(scratch.data(), record, (int)nx, window, roi_len);
+						ippsAdd_32f_I(scratch.data(), &crop_src(0, (int)j), (int)nx);
+					}
+
+					// Background sum over the tail
+					const uint16_t* bg_region = record + nx;
+					for (int k = 0; k < tail; k++)
+						sum += bg_region[k];
+				}
+
+				saturated((int)j) = mask;
+				bg_sum((int)j) = sum;
 			}
-		}
+		});
+
+		// 2. Find auto background level (of the binned lines)
+		uint64_t total = 0;
+		for (int j = 0; j < ny; j++)
+			total += bg_sum(j);
+		bg_level = (float)((double)total / ((double)tail * (double)ny)) + pParams.bg * (float)binning;
+	}
 
+	void operator() (const FLIM_PARAMS &pParams, int line0, int n_lines, float* yt, float* mt)
+	{
 		// 3. BG subtraction
-		//printf("%f %f\n", bg_auto, pParams.bg); //
-		ippsSubC_32f(crop_src.raw_ptr(), (float)(bg_auto) + pParams.bg, bgsub_src.raw_ptr(), bgsub_src.length());
-		//ippsSubC_32f(crop_src.raw_ptr(), (float)(bg_auto), bgsub_src.raw_ptr(), bgsub_src.length());
-		//ippsSubC_32f_I((float)(bg_auto)+pParams.bg, crop_src.raw_ptr(), crop_src.length());
+		ippsSubC_32f(&crop_src(0, line0), bg_level, &bgsub_src(0, line0), (int)nx * n_lines);
+
+		// 4. Up-sampling by cubic natural spline interpolation (coefficients only for the analytic method)
+		if (pParams.method == FLIM_METHOD_PHASOR)
+			return;
 
-		//// Parallel-for loop
-		//memcpy(ext_src.raw_ptr(), bgsub_src.raw_ptr(), sizeof(float) * crop_src.length());
-		memcpy(filt_src.raw_ptr(), bgsub_src.raw_ptr(), sizeof(float) * crop_src.length());
+		float* dst = ((pParams.method == FLIM_METHOD_UPSAMPLED) || materialize) ? &filt_src(0, line0) : nullptr;
+		_spline.block(dst, (int)nsite, &bgsub_src(0, line0), (int)nx, scoeff + line0 * (nx - 1) * 4, n_lines, yt, mt);
 
+		// 5. Software broadening by FIR Gaussian filtering
+		//for (int i = line0; i < line0 + n_lines; i++)
+		//	_filter(&filt_src(0, i), &ext_src(0, i), i);
+	}
+
+	// Self-test of the batched spline engine against the MKL path (flimSplineBenchmark, off by default)
+	// Own buffers only: the working state (scoeff) is left untouched. false: deviation above SPLINE_BENCHMARK_TOLERANCE
+	bool benchmark()
+	{
+		// Synthetic 4-channel pulse train at the current geometry
+		FloatArray2 test_src((int)nx, (int)ny);
+		FloatArray2 test_mkl((int)nsite, (int)ny);
+		FloatArray2 test_spline((int)nsite, (int)ny);
+		std::vector<float> coeff_mkl(ny * (nx - 1) * DF_PP_CUBIC);
+		std::vector<float> coeff_spline(ny * (nx - 1) * DF_PP_CUBIC);
+
+		for (int j = 0; j < ny; j++)
+		{
+			for (int k = 0; k < nx; k++)
+			{
+				float val = 0.0f;
+				for (int i = 0; i < 4; i++)
+				{
+					float t = (float)k - ((float)(ch_start_ind1[i] - ch_start_ind1[0]) / ActualFactor + 4.0f + 0.01f * (float)(j % 37));
+					val += (t < 0) ? std::exp(-0.5f * t * t) * 1000.0f : std::exp(-t / (3.0f + i)) * 1000.0f;
+				}
+				test_src(k, j) = val;
+			}
+		}
+
+		// 1. Per-line MKL task path
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
 		tbb::parallel_for(tbb::blocked_range<size_t>(0, (size_t)ny),
 			[&](const tbb::blocked_range<size_t>& r) {
 			for (size_t i = r.begin(); i != r.end(); ++i)
-			{
-				//float max_val; //int max_ind;
-				//			   //
-				//			   // 4. Jitter compensation
-				//int cpos = 6, rpos = 6;
-				//int irf_wlen = pParams.ch_start_ind[1] - pParams.ch_start_ind[0];
-				//ippsMaxIndx_32f(&bgsub_src(0, (int)i), irf_wlen, &max_val, &cpos);
-
-				//int offset = cpos - rpos;
-				//if (offset < 0) offset += bgsub_src.size(0);
-				//std::rotate(&bgsub_src(0, (int)i), &bgsub_src(offset, (int)i), &bgsub_src(crop_src.size(0) - 1, (int)i)); //////////////////////////////////////////////////
-
-				//																										  ///int end_ind4[4]; memcpy(end_ind4, ch_ind4 + 1, sizeof(int) * 4);
-				//																										  ///ippsSubC_32s_ISfs(ch_ind4[0], end_ind4, 4, 0);
-
-				// 6. Up-sampling by cubic natural spline interpolation
-				DFTaskPtr task1 = nullptr;
-
-				dfsNewTask1D(&task1, nx, x, DF_UNIFORM_PARTITION, 1, &bgsub_src(0, (int)i), DF_MATRIX_STORAGE_ROWS);
-				dfsEditPPSpline1D(task1, DF_PP_CUBIC, DF_PP_NATURAL, DF_BC_NOT_A_KNOT, 0, DF_NO_IC, 0, scoeff + (int)i * (nx - 1) * DF_PP_CUBIC, DF_NO_HINT);
-				dfsConstruct1D(task1, DF_PP_SPLINE, DF_METHOD_STD);
-				dfsInterpolate1D(task1, DF_INTERP, DF_METHOD_PP, nsite, x, DF_UNIFORM_PARTITION, 1, &dorder,
-					DF_NO_APRIORI_INFO, &filt_src(0, (int)i), DF_MATRIX_STORAGE_ROWS, NULL);
-				dfDeleteTask(&task1);
-
-				// 7. Software broadening by FIR Gaussian filtering
-				//_filter(&filt_src(0, (int)i), &ext_src(0, (int)i), (int)i);
-			}
+				mkl_spline(&test_mkl(0, (int)i), &test_src(0, (int)i), coeff_mkl.data() + (int)i * (nx - 1) * DF_PP_CUBIC);
 		});
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+		// 2. Batched engine
+		_spline(test_spline.raw_ptr(), (int)nsite, test_src.raw_ptr(), (int)nx, coeff_spline.data(), (int)ny);
+		std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+		float max_dev = 0.0f, max_val = 0.0f;
+		for (int i = 0; i < test_mkl.length(); i++)
+		{
+			max_dev = (std::max)(max_dev, std::fabs(test_mkl.raw_ptr()[i] - test_spline.raw_ptr()[i]));
+			max_val = (std::max)(max_val, std::fabs(test_mkl.raw_ptr()[i]));
+		}
+
+		bool passed = max_dev <= SPLINE_BENCHMARK_TOLERANCE * max_val;
+
+		char msg[256];
+		sprintf(msg, "FLIm spline engine: %.3f msec (MKL: %.3f msec), max deviation: %.3e (%.3e of peak) [%s]",
+			std::chrono::duration<double, std::milli>(t2 - t1).count(), std::chrono::duration<double, std::milli>(t1 - t0).count(),
+			max_dev, max_dev / max_val, passed ? "PASS" : "FAIL");
+		SendStatusMessage(msg);
+
+		return passed;
+	}
+
+	// Crop & saturation kernel of one record (ROI length and window length in multiples of CropBlock and WinBlock)
+	template <int CropBlock, int WinBlock>
+	static uint8_t ingest_line(float* crop, const uint16_t* record, int nx, const int* window, int roi_len)
+	{
+		// Crop ROI (u16 -> 32f)
+		if (CropBlock > 1)
+		{
+			for (int k = 0; k < nx; k += CropBlock)
+				for (int b = 0; b < CropBlock; b++)
+					crop[k + b] = (float)record[k + b];
+		}
+		else
+			ippsConvert_16u32f(record, crop, nx);
+
+		// Saturation flags (1 bit per channel)
+		uint8_t mask = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			const uint16_t* w = record + window[i];
+			int sat = 0;
+			for (int k = 0; k < roi_len; k += WinBlock)
+				for (int b = 0; b < WinBlock; b++)
+					sat |= (w[k + b] > 65531);
+			mask |= (uint8_t)(sat << i);
+		}
+
+		return mask;
 	}
 
 	void initialize(const FLIM_PARAMS& pParams, int _nx, int _upSampleFactor, int _alines)
@@ -208,43 +482,63 @@ public:
 			diff_ind[i] = ch_start_ind1[i + 1] - ch_start_ind1[i];
 
 		ippsMin_32s(diff_ind, 4, &pulse_roi_length);
+		roi_len = (int)round(pulse_roi_length / ActualFactor);
+
+		/* Ingest kernel specialized for the ROI lengths */
+		static const INGEST kernels[2][2] = {
+			{ ingest_line<1, 1>, ingest_line<1, 16> }, { ingest_line<16, 1>, ingest_line<16, 16> }
+		};
+		ingest = kernels[nx % 16 == 0][roi_len % 16 == 0];
+
 		char msg[256];
 		sprintf(msg, "FLIm Initializing... %d", pulse_roi_length);
 		SendStatusMessage(msg);
 
-		/* sequence for mean delay caculation */
-		if (pSeq) { ippsFree(pSeq); pSeq = nullptr; }
-		pSeq = ippsMalloc_32f(pulse_roi_length);
-		ippsVectorSlope_32f(pSeq, pulse_roi_length, 0, 1);
-
 		/* Array of spline coefficients */
 		if (scoeff) { delete[] scoeff; scoeff = nullptr; }
 		scoeff = new float[ny * (nx - 1) * DF_PP_CUBIC];
 
 		/* data buffer allocation */
 		crop_src = std::move(FloatArray2((int)nx, (int)ny));
-		sat_src = std::move(FloatArray2((int)nx, (int)ny));
 		bgsub_src = std::move(FloatArray2((int)nx, (int)ny));
 		ext_src = std::move(FloatArray2((int)nsite, (int)ny));
 		filt_src = std::move(FloatArray2((int)nsite, (int)ny));
 
-		saturated = std::move(FloatArray2(5, (int)ny));
-		memset(saturated, 0, sizeof(float) * saturated.length());
+		sint0 = std::move(Array<double, 2>((int)nx, (int)ny));
+		sint1 = std::move(Array<double, 2>((int)nx, (int)ny));
+
+		saturated = std::move(Uint8Array((int)ny));
+		memset(saturated, 0, sizeof(uint8_t) * saturated.length());
+		bg_sum = std::move(Uint32Array((int)ny));
 
-		/* filter coefficient allocation */
-		_filter.initialize(GAUSSIAN_FILTER_WIDTH, nsite, ny);
+		/* spline engine & filter coefficient allocation */
+		_spline.initialize((int)nx, (int)nsite);
+		_filter.initialize(pParams.filter_width, pParams.filter_std, nsite, ny);
 
 		initiated = true;
 	}
 
+private:
+	void mkl_spline(float* dst, const float* src, float* coeff)
+	{
+		DFTaskPtr task1 = nullptr;
+
+		dfsNewTask1D(&task1, nx, x, DF_UNIFORM_PARTITION, 1, src, DF_MATRIX_STORAGE_ROWS);
+		dfsEditPPSpline1D(task1, DF_PP_CUBIC, DF_PP_NATURAL, DF_BC_NOT_A_KNOT, 0, DF_NO_IC, 0, coeff, DF_NO_HINT);
+		dfsConstruct1D(task1, DF_PP_SPLINE, DF_METHOD_STD);
+		dfsInterpolate1D(task1, DF_INTERP, DF_METHOD_PP, nsite, x, DF_UNIFORM_PARTITION, 1, &dorder,
+			DF_NO_APRIORI_INFO, dst, DF_MATRIX_STORAGE_ROWS, NULL);
+		dfDeleteTask(&task1);
+	}
+
 private:
 	IppiSize srcSize;
-	float* scoeff;
 	float x[2];
 	MKL_INT dorder;
 
 public:
 	bool initiated;
+	bool materialize; // keep filt_src up to date for the analytic method (calibration view)
 
 	MKL_INT nx, ny; // original data length, dimension
 	MKL_INT nsite; // interpolated data length
@@ -253,15 +547,22 @@ public:
 	int upSampleFactor;
 	Ipp32f ActualFactor;
 	int pulse_roi_length;
+	int roi_len; // pulse roi length on the original samples
+
+	INGEST ingest;
 
+	SPLINE _spline;
 	FILTER _filter;
 
-	FloatArray2 saturated;
+	Uint8Array saturated; // saturation flags (bit i: channel i)
+	Uint32Array bg_sum;
 
-	Ipp32f* pSeq;
+	float* scoeff;
+	Array<double, 2> sint0, sint1; // running spline integrals of s(u) and u * s(u) at the knots (analytic method)
+
+	float bg_level;
 
 	FloatArray2 crop_src;
-	FloatArray2 sat_src;
 	FloatArray2 bgsub_src;
 	FloatArray2 ext_src;
 	FloatArray2 filt_src;
@@ -272,93 +573,216 @@ public:
 struct INTENSITY
 {
 public:
-	INTENSITY() : _ny(0) {}
+	INTENSITY() {}
 	~INTENSITY() {}
 
-	void operator() (const RESIZE& resize) // scans x 256 ==> 256 x 4
+	void operator() (const RESIZE& resize, const FLIM_PARAMS& pParams, int aline, const double* p0, const double* p1, FloatArray2& intensity) // scans x 256 ==> 256 x 4
 	{
-		if (_ny != resize.ny)
-		{
-			intensity = FloatArray2(resize.ny, 4);
-			_ny = resize.ny;
-		}
-
-		int offset;
+		float sum[4];
 		for (int i = 0; i < 4; i++)
 		{
-			for (int j = 0; j < intensity.size(0); j++)
+			sum[i] = 0.0f; // NAN;
+			if (!((resize.saturated(aline) >> i) & 1))
 			{
-				intensity(j, i) = 0.0f; // NAN;
-				if (resize.saturated(j, i) < 1)
+				if (pParams.method == FLIM_METHOD_ANALYTIC)
 				{
-					offset = resize.ch_start_ind1[i] - resize.ch_start_ind1[0];
-					ippsSum_32f(&resize.filt_src(offset, j), resize.pulse_roi_length, &intensity(j, i), ippAlgHintAccurate);
+					// Closed-form integral of the spline over the channel window (scaled to the up-sampled sum)
+					const float* coeff = resize.scoeff + aline * (resize.nx - 1) * 4;
+					double a = (double)(resize.ch_start_ind1[i] - resize.ch_start_ind1[0]) / resize.ActualFactor;
+					double b = a + (double)resize.pulse_roi_length / resize.ActualFactor;
+					double f0a, f1a, f0b, f1b;
+					resize._spline.integral(coeff, p0, p1, a, f0a, f1a);
+					resize._spline.integral(coeff, p0, p1, b, f0b, f1b);
+					sum[i] = (float)((f0b - f0a) * resize.ActualFactor);
+				}
+				else
+				{
+					int offset = resize.ch_start_ind1[i] - resize.ch_start_ind1[0];
+					ippsSum_32f(&resize.filt_src(offset, aline), resize.pulse_roi_length, &sum[i], ippAlgHintAccurate);
 				}
 			}
 		}
 
+		// Normalization by IRF intensity
 		for (int i = 0; i < 4; i++)
-		    ippsDiv_32f_I(&intensity(0, 0), &intensity(0, 3 - i), intensity.size(0));
+			intensity(aline, i) = sum[i] / sum[0];
 	}
-
-public:
-	int _ny;
-	np::FloatArray2 intensity;
 };
 
 struct LIFETIME
 {
 public:
-	LIFETIME() : _ny(0) {}
+	LIFETIME() : iterations(std::array<int, 11>()) {}
 	~LIFETIME() {}
 
-	void operator() (const RESIZE& resize, const FLIM_PARAMS& pParams, FloatArray2& intensity)
+	// Width & mean delay only of the (A-line, channel) pairs above the intensity threshold
+	void operator() (const RESIZE& resize, const FLIM_PARAMS& pParams, const FloatArray2& intensity, FloatArray2& mean_delay, FloatArray2& lifetime)
 	{
-		if (_ny != resize.ny)
+		int ny = (int)resize.ny;
+
+		// 1. Compact the active pairs (the IRF channel is needed whenever any emission channel is)
+		active.clear();
+		for (int i = 0; i < ny; i++)
 		{
-			mean_delay = FloatArray2(resize.ny, 4);
-			lifetime = FloatArray2(resize.ny, 3);
-			_ny = resize.ny;
+			bool any = false;
+			for (int j = 1; j < 4; j++)
+				any |= (intensity(i, j) > pParams.intensity_thres);
+			if (!any)
+				continue;
+
+			active.push_back(4 * i);
+			for (int j = 1; j < 4; j++)
+				if (intensity(i, j) > pParams.intensity_thres)
+					active.push_back(4 * i + j);
 		}
 
-		tbb::parallel_for(tbb::blocked_range<size_t>(0, (size_t)resize.ny),
-			[&](const tbb::blocked_range<size_t>& r) {
-			for (size_t i = r.begin(); i != r.end(); ++i)
-			{
-				for (int j = 0; j < 4; j++)
-				{
-					int offset, width, left, maxIdx;
-					float md_temp;
-					offset = resize.ch_start_ind1[j] - resize.ch_start_ind1[0];
-
-					// 1. Get each pulse width
-					const float* pulse = &resize.filt_src(offset, (int)i);
-					WidthIndex_32f(pulse, 0.5f, resize.pulse_roi_length, maxIdx, width);
-					roiWidth[j] = (int)round(pParams.width_factor * width);
-					left = (int)floor(roiWidth[j] / 2);
-
-					// 2. Get mean delay of each channel (iterative process)
-					MeanDelay_32f(resize, &resize.filt_src(offset, (int)i), offset, (int)i, maxIdx, roiWidth[j], left, md_temp);
-					mean_delay((int)i, j) = (md_temp + (float)resize.ch_start_ind1[j]) / resize.ActualFactor;
-				}
+		for (int i = 0; i < ny; i++)
+			for (int j = 0; j < 4; j++)
+				mean_delay(i, j) = 0.0f;
 
-				// 3. Subtract mean delay of IRF to mean delay of each channel
-				for (int j = 0; j < 3; j++)
-				{
-					if ((intensity((int)i, j + 1) > INTENSITY_THRES))
-						lifetime((int)i, j) = pParams.samp_intv * (mean_delay((int)i, j + 1) - mean_delay((int)i, 0)) - pParams.delay_offset[j];
-					else
-						lifetime((int)i, j) = 0.0f; // NAN;
-				}
+		// 2. Width & mean delay in load-balanced chunks of SPLINE_LANES pairs (scattered back to mean_delay)
+		int n_active = (int)active.size();
+		int n_chunks = (n_active + SPLINE_LANES - 1) / SPLINE_LANES;
+
+		tbb::parallel_for(tbb::blocked_range<int>(0, n_chunks),
+			[&](const tbb::blocked_range<int>& r) {
+			for (int c = r.begin(); c != r.end(); ++c)
+			{
+				int k0 = c * SPLINE_LANES;
+				chunk(resize, pParams, active.data() + k0, (std::min)(SPLINE_LANES, n_active - k0), mean_delay);
 			}
 		});
 
-		//QFile file("temp.data");
-		//if (file.open(QIODevice::WriteOnly))
-		//{
-		//	file.write(reinterpret_cast<char*>(mean_delay.raw_ptr()), sizeof(float) * mean_delay.length());
-		//	file.close();
-		//}
+		// 3. Subtract mean delay of IRF to mean delay of each channel
+		for (int i = 0; i < ny; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				if ((intensity(i, j + 1) > pParams.intensity_thres))
+					lifetime(i, j) = pParams.samp_intv * (mean_delay(i, j + 1) - mean_delay(i, 0)) - pParams.delay_offset[j];
+				else
+					lifetime(i, j) = 0.0f; // NAN;
+			}
+		}
+	}
+
+	// Up to SPLINE_LANES pairs (pair: 4 * aline + channel)
+	void chunk(const RESIZE& resize, const FLIM_PARAMS& pParams, const int* pair, int n_lanes, FloatArray2& mean_delay)
+	{
+		const Ipp32f* src[SPLINE_LANES];
+		int maxIdx[SPLINE_LANES], width[SPLINE_LANES];
+		int nx = (int)resize.nx;
+
+		if (pParams.method == FLIM_METHOD_ANALYTIC)
+		{
+			float length = (float)resize.pulse_roi_length / resize.ActualFactor;
+			float start[SPLINE_LANES];
+			int offset[SPLINE_LANES];
+
+			// 1. Get each pulse width on the original samples
+			for (int l = 0; l < n_lanes; l++)
+			{
+				int i = pair[l] / 4, j = pair[l] % 4;
+				start[l] = (float)(resize.ch_start_ind1[j] - resize.ch_start_ind1[0]) / resize.ActualFactor;
+				offset[l] = (int)round(start[l]);
+				src[l] = &resize.bgsub_src(offset[l], i);
+			}
+			WidthIndexBatch_32f(src, 0.5f, (int)round(length), n_lanes, maxIdx, width);
+
+			// 2. Get mean delay of each channel from the spline moments (iterative process)
+			for (int l = 0; l < n_lanes; l++)
+			{
+				int i = pair[l] / 4, j = pair[l] % 4;
+				float md_temp;
+				const float* coeff = resize.scoeff + i * (nx - 1) * 4;
+				MeanDelayAnalytic_32f(resize, coeff, &resize.sint0(0, i), &resize.sint1(0, i), start[l], length,
+					(float)(offset[l] + maxIdx[l]) - start[l], pParams.width_factor * (float)width[l], md_temp);
+				mean_delay(i, j) = md_temp + (float)resize.ch_start_ind1[j] / resize.ActualFactor;
+			}
+		}
+		else
+		{
+			int offset[SPLINE_LANES];
+
+			// 1. Get each pulse width
+			for (int l = 0; l < n_lanes; l++)
+			{
+				int i = pair[l] / 4, j = pair[l] % 4;
+				offset[l] = resize.ch_start_ind1[j] - resize.ch_start_ind1[0];
+				src[l] = &resize.filt_src(offset[l], i);
+			}
+			WidthIndexBatch_32f(src, 0.5f, resize.pulse_roi_length, n_lanes, maxIdx, width);
+
+			// 2. Get mean delay of each channel (iterative process)
+			for (int l = 0; l < n_lanes; l++)
+			{
+				int i = pair[l] / 4, j = pair[l] % 4;
+				float md_temp;
+				int roi_width = (int)round(pParams.width_factor * width[l]);
+				int left = (int)floor(roi_width / 2);
+
+				MeanDelay_32f(resize, src[l], offset[l], i, maxIdx[l], roi_width, left, md_temp);
+				mean_delay(i, j) = (md_temp + (float)resize.ch_start_ind1[j]) / resize.ActualFactor;
+			}
+		}
+	}
+
+	// Same as WidthIndex_32f for up to SPLINE_LANES pulses (lane l at src[l]) in a lane-interleaved tile
+	void WidthIndexBatch_32f(const Ipp32f* const* src, Ipp32f th, Ipp32s length, int n_lanes, Ipp32s* maxIdx, Ipp32s* width)
+	{
+		const int L = SPLINE_LANES;
+
+		static thread_local std::vector<float> tile;
+		if ((int)tile.size() < length * L)
+			tile.resize(length * L);
+		float* t = tile.data();
+
+		// 1. Transpose
+		for (int l = 0; l < n_lanes; l++)
+			for (int k = 0; k < length; k++)
+				t[k * L + l] = src[l][k];
+		for (int l = n_lanes; l < L; l++)
+			for (int k = 0; k < length; k++)
+				t[k * L + l] = 0.0f;
+
+		// 2. Peak (first maximum)
+		float maxVal[L], thres[L];
+		int idx[L], left0[L], right0[L];
+		for (int l = 0; l < L; l++)
+		{
+			maxVal[l] = t[l];
+			idx[l] = 0;
+		}
+		for (int k = 1; k < length; k++)
+		{
+			for (int l = 0; l < L; l++)
+			{
+				float v = t[k * L + l];
+				bool greater = v > maxVal[l];
+				maxVal[l] = greater ? v : maxVal[l];
+				idx[l] = greater ? k : idx[l];
+			}
+		}
+
+		// 3. Last crossing at or before the peak, first crossing at or after the peak
+		for (int l = 0; l < L; l++)
+		{
+			thres[l] = maxVal[l] * th;
+			left0[l] = 0;
+			right0[l] = 0;
+		}
+		for (int k = 0; k < length; k++)
+			for (int l = 0; l < L; l++)
+				left0[l] = ((k <= idx[l]) && (t[k * L + l] < thres[l])) ? k : left0[l];
+		for (int k = length - 1; k >= 0; k--)
+			for (int l = 0; l < L; l++)
+				right0[l] = ((k >= idx[l]) && (t[k * L + l] < thres[l])) ? k : right0[l];
+
+		for (int l = 0; l < n_lanes; l++)
+		{
+			maxIdx[l] = idx[l];
+			width[l] = right0[l] - left0[l] + 1;
+		}
 	}
 
 	void WidthIndex_32f(const Ipp32f* src, Ipp32f th, Ipp32s length, Ipp32s& maxIdx, Ipp32s& width)
@@ -389,8 +813,24 @@ public:
 
 	void MeanDelay_32f(const RESIZE& resize, const float* pulse, int offset, int aline, Ipp32s maxIdx, Ipp32s width, Ipp32s left, Ipp32f &mean_delay)
 	{
-		Ipp32f sum, weight_sum;
-		int start;
+		// Cumulative zeroth & first moments over the pulse ROI
+		static thread_local std::vector<double> m0, m1;
+		int length = resize.pulse_roi_length;
+		if ((int)m0.size() < length + 1)
+		{
+			m0.resize(length + 1);
+			m1.resize(length + 1);
+		}
+
+		m0[0] = 0; m1[0] = 0;
+		for (int k = 0; k < length; k++)
+		{
+			m0[k + 1] = m0[k] + pulse[k];
+			m1[k + 1] = m1[k] + (double)k * pulse[k];
+		}
+
+		double sum, weight_sum;
+		int start, prev_start = -1, n_iter = 0;
 
 		mean_delay = (float)maxIdx;
 
@@ -401,31 +841,24 @@ public:
 			if (isnan(mean_delay))
 				break;
 
-			//if ((start < 0) || (start + width > resize.pulse_roi_length))
-			//{
-			//    mean_delay = 0;
-			//    break;
-			//}
-
-			//const float* pulse = &resize.ext_src(offset, aline);
-			sum = 0; weight_sum = 0;
+			// Window stopped moving: converged
+			if (start == prev_start)
+				break;
 
-			if (resize.pSeq)
+			if (offset + start <= 0)
 			{
-				if (offset + start > 0)
-				{
-					ippsDotProd_32f(pulse + start, &resize.pSeq[start], width, &weight_sum);
-					ippsSum_32f(pulse + start, width, &sum, ippAlgHintFast);
-				}
-				else
-				{
-					mean_delay = 0;
-					break;
-				}
+				mean_delay = 0;
+				break;
 			}
 
+			n_iter++;
+
+			int a = (std::max)(start, 0), b = (std::min)(start + width, length);
+			sum = (b > a) ? m0[b] - m0[a] : 0;
+			weight_sum = (b > a) ? m1[b] - m1[a] : 0;
+
 			if (sum)
-				mean_delay = weight_sum / sum;
+				mean_delay = (float)(weight_sum / sum);
 			else
 			{
 				mean_delay = 0;
@@ -437,16 +870,213 @@ public:
 				mean_delay = 0;
 				break;
 			}
+
+			prev_start = start;
 		}
+
+		iterations.local()[n_iter]++;
+
+		(void)aline;
+	}
+
+	void MeanDelayAnalytic_32f(const RESIZE& resize, const float* coeff, const double* p0, const double* p1,
+		Ipp32f start, Ipp32f length, Ipp32f peak, Ipp32f width, Ipp32f &mean_delay)
+	{
+		double f0a, f1a, f0b, f1b, sum;
+		float md;
+		int n_iter = 0;
+
+		mean_delay = peak;
+
+		for (int i = 0; i < 10; i++)
+		{
+			double a = (double)(start + mean_delay) - 0.5 * width;
+			if (a <= 0)
+			{
+				mean_delay = 0;
+				break;
+			}
+
+			n_iter++;
+
+			// Window clipped to the channel ROI [start, start + length]
+			double b = (std::min)(a + width, (double)(start + length));
+			a = (std::max)(a, (double)start);
+
+			if (b > a)
+			{
+				resize._spline.integral(coeff, p0, p1, a, f0a, f1a);
+				resize._spline.integral(coeff, p0, p1, b, f0b, f1b);
+				sum = f0b - f0a;
+			}
+			else
+				sum = 0;
+
+			if (sum)
+				md = (float)((f1b - f1a) / sum) - start;
+			else
+			{
+				mean_delay = 0;
+				break;
+			}
+
+			if ((md > length) || (md < 0) || isnan(md))
+			{
+				mean_delay = 0;
+				break;
+			}
+
+			bool converged = fabs(md - mean_delay) < 1e-4f;
+			mean_delay = md;
+			if (converged)
+				break;
+		}
+
+		iterations.local()[n_iter]++;
 	}
 
 public:
-	int roiWidth[4];
-	int _ny;
-	FloatArray2 mean_delay;
+	tbb::enumerable_thread_specific<std::array<int, 11>> iterations; // mean delay iteration counts
+	std::vector<int> active; // compacted (A-line, channel) pairs above the intensity threshold
+
+	bool keep_latest = false; // calibration view open: copy of the latest results
+	FloatArray2 mean_delay; // latest results (for calibration view, owned: the result buffers go back to their lanes)
 	FloatArray2 lifetime;
 };
 
+#define PHASOR_HIST_BINS 128
+
+struct PHASOR // Phasor (DFT harmonic) lifetime estimation on the cropped pulse
+{
+public:
+	PHASOR() : length(0), ny(0), samp_intv(0.0f)
+	{
+	}
+
+	~PHASOR()
+	{
+	}
+
+	void operator() (const RESIZE& resize, const FLIM_PARAMS& pParams, int line0, int n_lines,
+		FloatArray2& intensity, FloatArray2& mean_delay, FloatArray2& lifetime)
+	{
+		const double two_pi = 6.283185307179586;
+
+		for (int i = line0; i < line0 + n_lines; i++)
+		{
+			std::complex<double> P[4];
+			float sum[4];
+
+			// 1. Intensity and the first harmonic of each channel window
+			for (int j = 0; j < 4; j++)
+			{
+				int start = pParams.ch_start_ind[j] - pParams.ch_start_ind[0];
+				const float* pulse = &resize.bgsub_src(start, i);
+
+				sum[j] = 0.0f;
+				if (!((resize.saturated(i) >> j) & 1))
+					ippsSum_32f(pulse, length, &sum[j], ippAlgHintFast);
+
+				float re, im;
+				ippsDotProd_32f(pulse, cos_table.data(), length, &re);
+				ippsDotProd_32f(pulse, sin_table.data(), length, &im);
+				P[j] = std::complex<double>(re, im) / (double)(sum[j] ? sum[j] : 1.0f);
+
+				// Phase delay of the window (samples)
+				double phi = std::arg(P[j]);
+				if (phi < 0) phi += two_pi;
+				mean_delay(i, j) = (float)(phi / two_pi * length) + (float)pParams.ch_start_ind[j];
+			}
+
+			// 2. Normalization by IRF intensity
+			for (int j = 0; j < 4; j++)
+				intensity(i, j) = sum[j] / sum[0];
+
+			// 3. Decay phasor: channel over IRF, referred to the IRF time origin and delay offset
+			for (int j = 0; j < 3; j++)
+			{
+				bool valid = (intensity(i, j + 1) > pParams.intensity_thres) && (sum[0] != 0) && (sum[j + 1] != 0);
+				double shift = (double)(pParams.ch_start_ind[j + 1] - pParams.ch_start_ind[0]) * samp_intv - pParams.delay_offset[j];
+
+				std::complex<double> D = (P[j + 1] / P[0]) * std::polar(1.0, omega * shift);
+				g(i, j) = valid ? (float)D.real() : 0.0f;
+				s(i, j) = valid ? (float)D.imag() : 0.0f;
+
+				// Phase lifetime
+				lifetime(i, j) = valid ? (float)(std::tan(std::arg(D)) / omega) : 0.0f; // NAN;
+			}
+		}
+	}
+
+	void initialize(const FLIM_PARAMS& pParams, int _ny)
+	{
+		int _length = pParams.ch_start_ind[1] - pParams.ch_start_ind[0];
+		for (int i = 1; i < 4; i++)
+			_length = (std::min)(_length, pParams.ch_start_ind[i + 1] - pParams.ch_start_ind[i]);
+
+		if ((_length == length) && (_ny == ny) && (pParams.samp_intv == samp_intv))
+			return;
+
+		/* Parameters */
+		length = _length; ny = _ny;
+		samp_intv = pParams.samp_intv;
+		omega = 6.283185307179586 / ((double)length * samp_intv); // rad/nsec
+
+		/* First harmonic table over one window */
+		cos_table.resize(length);
+		sin_table.resize(length);
+		for (int k = 0; k < length; k++)
+		{
+			cos_table[k] = (float)std::cos(6.283185307179586 * k / length);
+			sin_table[k] = (float)std::sin(6.283185307179586 * k / length);
+		}
+
+		/* data buffer allocation */
+		g = std::move(FloatArray2(ny, 3));
+		s = std::move(FloatArray2(ny, 3));
+
+		for (int i = 0; i < 3; i++)
+			histogram[i] = std::move(Uint32Array2(PHASOR_HIST_BINS, PHASOR_HIST_BINS));
+		clearHistogram();
+	}
+
+	// Accumulate the first harmonic decay phasors of the last buffer (g: 0 ~ 1, s: 0 ~ 0.5)
+	void accumulate(const FLIM_PARAMS& pParams, const FloatArray2& intensity)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			for (int i = 0; i < ny; i++)
+			{
+				if (intensity(i, j + 1) > pParams.intensity_thres)
+				{
+					int gx = (int)(g(i, j) * PHASOR_HIST_BINS);
+					int sy = (int)(s(i, j) * 2 * PHASOR_HIST_BINS);
+					if ((gx >= 0) && (gx < PHASOR_HIST_BINS) && (sy >= 0) && (sy < PHASOR_HIST_BINS))
+						histogram[j](gx, sy)++;
+				}
+			}
+		}
+	}
+
+	void clearHistogram()
+	{
+		for (int i = 0; i < 3; i++)
+			if (histogram[i].length())
+				memset(histogram[i], 0, sizeof(uint32_t) * histogram[i].length());
+	}
+
+public:
+	int length, ny;
+	float samp_intv;
+	double omega;
+
+	std::vector<float> cos_table;
+	std::vector<float> sin_table;
+
+	FloatArray2 g, s; // first harmonic decay phasors of channel 1~3
+	Uint32Array2 histogram[3];
+};
+
 
 class FLImProcess
 {
@@ -461,15 +1091,27 @@ private: // Not to call copy constrcutor and copy assignment operator
 
 public:
 	// Generate fluorescence intensity & lifetime
-	void operator()(FloatArray2& intensity, FloatArray2& mean_delay, FloatArray2& lifetime, FloatArray2& pulse);
+	void operator()(FloatArray2& intensity, FloatArray2& mean_delay, FloatArray2& lifetime, Uint16Array2& pulse);
 
 	// For FLIM parameters setting
 	void setParameters(Configuration* pConfig);
 
+	// Worker instances follow the parameters of the master instance through a versioned snapshot:
+	// the master publishes after each change (GUI thread), a worker copies it when the version moved (worker thread)
+	void publishParameters();
+	void syncParameters(const FLImProcess& master);
+
 	// For masking
 	void saveMaskData(QString maskpath = "flim_mask.dat");
 	void loadMaskData(QString maskpath = "flim_mask.dat");
 
+	// Report & reset the distribution of mean delay iterations
+	void reportIterations();
+
+	// Phasor histograms: each worker adds its own to the master instance at the end of the acquisition (any thread),
+	// the master reports (then clears) the merged histograms once all n_workers were merged
+	void mergePhasorHistogram(FLImProcess& master, int n_workers);
+
 	// Variables
 public:
 	FLIM_PARAMS _params;
@@ -477,6 +1119,20 @@ public:
 	RESIZE _resize; // resize objects
 	INTENSITY _intensity; // intensity objects
 	LIFETIME _lifetime; // lifetime objects
+	PHASOR _phasor; // phasor objects
+
+private:
+	// Phasor histograms merged over the workers (master instance)
+	std::mutex _phasor_mutex;
+	Uint32Array2 _phasor_histogram[3];
+	int _phasor_merges = 0;
+
+	// Published parameters (master instance) & version of the last copy (worker instance)
+	mutable std::mutex _params_mutex;
+	FLIM_PARAMS _params_published;
+	bool _materialize_published = false;
+	std::atomic<uint32_t> _params_version{ 0 };
+	uint32_t _params_synced = 0;
 
 public:
 	// Callbacks
@@ -0,0 +1,230 @@
+
+#include "BidirEstimator.h"
+
+#include <Common/RealTime.h>
+
+#include <cmath>
+#include <algorithm>
+
+
+BidirEstimator::BidirEstimator() :
+	running(false), tracking(false), pending(false), stopping(false), input_width(0), input_pairs(0), input_binning(1),
+	width(0), pairs(0), binning(1), tracked(0.0f), has_tracked(false),
+	order(0), length(0), pFFTSpec(nullptr), pMemSpec(nullptr), pMemInit(nullptr), pMemBuffer(nullptr),
+	shift(0.0f), revision(0)
+{
+}
+
+BidirEstimator::~BidirEstimator()
+{
+	stop();
+	release();
+}
+
+
+void BidirEstimator::start(bool _tracking)
+{
+	stop();
+
+	tracking = _tracking;
+	has_tracked = false;
+	pending = false;
+	stopping = false;
+	running = true;
+
+	thread = std::thread([&]() { run(); });
+	RealTime::setPriority(thread, RT_PRIORITY_LOW);
+}
+
+void BidirEstimator::stop()
+{
+	if (!thread.joinable())
+		return;
+
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		stopping = true;
+	}
+	cv.notify_one();
+	thread.join();
+}
+
+void BidirEstimator::offer(const float* sum_intensity, const float* count, int _width, int _lines, int _binning)
+{
+	if (!running || (_width < 8) || (_lines < 2))
+		return;
+
+	std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+	if (!lock.owns_lock() || pending || stopping)
+		return;
+
+	// Averaged intensity of the line pairs (no valid sample: 0)
+	int n_pairs = _lines / 2;
+	input_pairs = (std::min)(n_pairs, BIDIR_ESTIMATOR_PAIRS);
+	input_width = _width;
+	input_binning = _binning;
+	input.resize((size_t)2 * input_pairs * _width);
+	for (int p = 0; p < input_pairs; p++)
+	{
+		int y = 2 * (p * n_pairs / input_pairs);
+		for (int d = 0; d < 2; d++)
+		{
+			const float* s = sum_intensity + (size_t)(y + d) * _width;
+			const float* n = count + (size_t)(y + d) * _width;
+			float* dst = &input[(size_t)(2 * p + d) * _width];
+			for (int x = 0; x < _width; x++)
+			{
+				float v = s[x] / n[x];
+				dst[x] = std::isfinite(v) ? v : 0.0f;
+			}
+		}
+	}
+
+	pending = true;
+	lock.unlock();
+	cv.notify_one();
+}
+
+bool BidirEstimator::fetch(float* _shift, uint32_t* _revision) const
+{
+	uint32_t r = revision.load(std::memory_order_acquire);
+	if (r == *_revision)
+		return false;
+
+	*_shift = shift.load(std::memory_order_relaxed);
+	*_revision = r;
+
+	return true;
+}
+
+
+void BidirEstimator::run()
+{
+	while (true)
+	{
+		// Wait for a frame
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait(lock, [&]() { return pending || stopping; });
+			if (stopping)
+				break;
+
+			lines.swap(input);
+			width = input_width;
+			pairs = input_pairs;
+			binning = input_binning;
+			pending = false;
+		}
+
+		float _shift, coefficient;
+		if (!estimate(&_shift, &coefficient))
+			continue;
+
+		// Publish (drift tracking: smoothed)
+		tracked = (tracking && has_tracked) ? tracked + BIDIR_TRACKING_GAIN * (_shift - tracked) : _shift;
+		has_tracked = true;
+
+		shift.store(tracked, std::memory_order_relaxed);
+		revision.fetch_add(1, std::memory_order_release);
+		DidEstimate(tracked, coefficient);
+
+		if (!tracking)
+			break;
+	}
+
+	running = false;
+}
+
+bool BidirEstimator::estimate(float* _shift, float* coefficient)
+{
+	initialize(width);
+
+	// Cross-power spectrum summed over the line pairs: F(forward) * conj(F(flipped backward))
+	std::fill(spectrum.begin(), spectrum.end(), 0.0f);
+	Ipp32f energy_forward = 0.0f, energy_backward = 0.0f;
+	for (int p = 0; p < pairs; p++)
+	{
+		const float* line_forward = &lines[(size_t)(2 * p) * width];
+		const float* line_backward = &lines[(size_t)(2 * p + 1) * width];
+
+		Ipp32f mean, energy;
+		ippsMean_32f(line_forward, width, &mean, ippAlgHintFast);
+		ippsSubC_32f(line_forward, mean, forward.data(), width);
+		ippsDotProd_32f(forward.data(), forward.data(), width, &energy);
+		energy_forward += energy;
+
+		ippsFlip_32f(line_backward, backward.data(), width);
+		ippsMean_32f(backward.data(), width, &mean, ippAlgHintFast);
+		ippsSubC_32f_I(mean, backward.data(), width);
+		ippsDotProd_32f(backward.data(), backward.data(), width, &energy);
+		energy_backward += energy;
+
+		ippsZero_32f(forward.data() + width, length - width);
+		ippsZero_32f(backward.data() + width, length - width);
+		ippsFFTFwd_RToPack_32f_I(forward.data(), pFFTSpec, pMemBuffer);
+		ippsFFTFwd_RToPack_32f_I(backward.data(), pFFTSpec, pMemBuffer);
+		ippsMulPackConj_32f_I(backward.data(), forward.data(), length);
+		ippsAdd_32f_I(forward.data(), spectrum.data(), length);
+	}
+	if ((energy_forward <= 0.0f) || (energy_backward <= 0.0f))
+		return false;
+
+	// Correlation c(r) = sum of forward(x + r) * flipped backward(x), corrected for the overlap of the lines
+	ippsFFTInv_PackToR_32f(spectrum.data(), correlation.data(), pFFTSpec, pMemBuffer);
+	auto c = [&](int r) { return correlation[(r + length) % length] * (float)width / (float)(width - std::abs(r)); };
+
+	int range = (std::min)(BIDIR_MAX_SHIFT / binning, width / 2);
+	int peak = -range;
+	for (int r = -range + 1; r <= range; r++)
+		if (c(r) > c(peak))
+			peak = r;
+	if ((peak == -range) || (peak == range)) // no maximum inside the range
+		return false;
+
+	*coefficient = c(peak) / sqrtf(energy_forward * energy_backward);
+	if (*coefficient < BIDIR_MIN_CORRELATION)
+		return false;
+
+	// Sub-pixel peak (parabola through the 3 samples around the maximum)
+	float c0 = c(peak - 1), c1 = c(peak), c2 = c(peak + 1);
+	float denom = c0 - 2.0f * c1 + c2;
+	float delta = (denom < 0.0f) ? 0.5f * (c0 - c2) / denom : 0.0f;
+
+	// Backward line (flipped) matches the forward line shifted by the estimate: the FrameAssembler bidir_shift
+	*_shift = ((float)peak + delta) * (float)binning;
+
+	return true;
+}
+
+void BidirEstimator::initialize(int _width)
+{
+	int _order = (int)ceil(log2(2.0 * _width));
+	if (_order == order)
+		return;
+
+	release();
+	order = _order;
+	length = 1 << order;
+
+	int sizeSpec, sizeInit, sizeBuffer;
+	ippsFFTGetSize_R_32f(order, IPP_FFT_DIV_INV_BY_N, ippAlgHintNone, &sizeSpec, &sizeInit, &sizeBuffer);
+
+	pMemSpec = ippsMalloc_8u(sizeSpec);
+	pMemInit = (sizeInit > 0) ? ippsMalloc_8u(sizeInit) : nullptr;
+	pMemBuffer = (sizeBuffer > 0) ? ippsMalloc_8u(sizeBuffer) : nullptr;
+	ippsFFTInit_R_32f(&pFFTSpec, order, IPP_FFT_DIV_INV_BY_N, ippAlgHintNone, pMemSpec, pMemInit);
+
+	forward.assign(length, 0.0f);
+	backward.assign(length, 0.0f);
+	spectrum.assign(length, 0.0f);
+	correlation.assign(length, 0.0f);
+}
+
+void BidirEstimator::release()
+{
+	if (pMemSpec) { ippsFree(pMemSpec); pMemSpec = nullptr; }
+	if (pMemInit) { ippsFree(pMemInit); pMemInit = nullptr; }
+	if (pMemBuffer) { ippsFree(pMemBuffer); pMemBuffer = nullptr; }
+	pFFTSpec = nullptr;
+	order = 0;
+}
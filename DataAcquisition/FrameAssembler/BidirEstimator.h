@@ -0,0 +1,87 @@
+#ifndef BIDIR_ESTIMATOR_H
+#define BIDIR_ESTIMATOR_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+#include <ipps.h>
+
+#include <Common/callback.h>
+
+#define BIDIR_ESTIMATOR_PAIRS		32 // forward & backward line pairs per estimate (spread over the frame)
+#define BIDIR_MAX_SHIFT				100 // search range of the shift [raw pixel]
+#define BIDIR_MIN_CORRELATION		0.2f // correlation coefficient at the peak for a valid estimate
+#define BIDIR_TRACKING_GAIN			0.25f // smoothing of the tracked shift (drift tracking)
+
+
+// Background estimation of the bidirectional scan shift (biDirScanComp) on a low priority thread:
+// cross-correlation of the forward lines and the flipped backward lines of a frame (FFT, summed over line pairs),
+// peak refined to sub-pixel with a parabola. The shift is published through a lock-free slot read by the frame assembly.
+class BidirEstimator
+{
+public:
+	BidirEstimator();
+	virtual ~BidirEstimator();
+
+private: // Not to call copy constrcutor and copy assignment operator
+	BidirEstimator(const BidirEstimator&);
+	BidirEstimator& operator=(const BidirEstimator&);
+
+public:
+	// One estimate, or continuous drift tracking until stop()
+	void start(bool tracking);
+	void stop();
+	inline bool isRunning() const { return running; }
+
+	// Frame assembly: accumulated lines of one channel as acquired (stride: width, even lines forward, odd lines backward).
+	// Copied only when the estimator waits for a frame: never blocks the caller.
+	void offer(const float* sum_intensity, const float* count, int width, int lines, int binning);
+
+	// Parameter slot: true with the shift [raw pixel] when it was published after *revision
+	bool fetch(float* shift, uint32_t* revision) const;
+
+public:
+	callback2<float, float> DidEstimate; // shift [raw pixel], correlation coefficient (estimator thread)
+
+private:
+	void run();
+	bool estimate(float* shift, float* correlation);
+	void initialize(int width);
+	void release();
+
+private:
+	std::thread thread;
+	std::atomic<bool> running;
+	bool tracking;
+
+	// Offered lines [2 * pair + (0: forward, 1: backward)][width] (guarded by mtx)
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool pending, stopping;
+	std::vector<float> input;
+	int input_width, input_pairs, input_binning;
+
+	// Estimator thread
+	std::vector<float> lines;
+	int width, pairs, binning;
+	float tracked;
+	bool has_tracked;
+
+	// Real FFT (zero padded to 2^order >= 2 * width: no circular wrap of the shifts)
+	int order, length;
+	IppsFFTSpec_R_32f* pFFTSpec;
+	Ipp8u* pMemSpec;
+	Ipp8u* pMemInit;
+	Ipp8u* pMemBuffer;
+	std::vector<Ipp32f> forward, backward, spectrum, correlation;
+
+	// Published shift
+	std::atomic<float> shift;
+	std::atomic<uint32_t> revision;
+};
+
+#endif // BIDIR_ESTIMATOR_H
@@ -0,0 +1,154 @@
+
+#include "CrsTable.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTextStream>
+#include <QStringList>
+
+#include <cmath>
+#include <algorithm>
+
+
+CrsTable::CrsTable() :
+	revision(0), from_sidecar(false), n_pixels(0), binning(0), compiled_revision(-1)
+{
+}
+
+CrsTable::~CrsTable()
+{
+}
+
+
+bool CrsTable::load(const QString& path)
+{
+	QFileInfo info(path);
+	if (!info.exists())
+		return false;
+
+	int64_t source_size = (int64_t)info.size();
+	int64_t source_time = (int64_t)info.lastModified().toMSecsSinceEpoch();
+
+	// Compiled table: the sidecar when it was built from this text file, otherwise parse & rebuild the sidecar
+	std::vector<int> _raw_index;
+	std::vector<float> _raw_weight;
+	bool sidecar = readSidecar(sidecarPath(path), source_size, source_time, _raw_index, _raw_weight);
+	if (!sidecar)
+	{
+		if (!readText(path, _raw_index, _raw_weight))
+			return false;
+		writeSidecar(sidecarPath(path), source_size, source_time, _raw_index, _raw_weight);
+	}
+
+	std::unique_lock<std::mutex> lock(mtx);
+	raw_index.swap(_raw_index);
+	raw_weight.swap(_raw_weight);
+	from_sidecar = sidecar;
+	revision++;
+
+	return true;
+}
+
+bool CrsTable::compile(int _n_pixels, int _binning)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	if ((_n_pixels == n_pixels) && (_binning == binning) && (revision == compiled_revision))
+		return !index.empty();
+
+	n_pixels = _n_pixels;
+	binning = _binning;
+	compiled_revision = revision;
+
+	int width = n_pixels / binning;
+	if ((width < 2) || raw_index.empty())
+	{
+		index.clear();
+		weight.clear();
+		return false;
+	}
+
+	// Resample to the binned line (source position = index + 1 - weight)
+	// Pixels beyond the end of a shorter table are not compensated (identity: index k, weight 1)
+	index.resize(width);
+	weight.resize(width);
+	for (int k = 0; k < width; k++)
+	{
+		int k0 = k * binning;
+		float raw_pos = (k0 < (int)raw_index.size()) ? (float)raw_index[k0] + 1.0f - raw_weight[k0] : (float)k0;
+		float pos = raw_pos / (float)binning;
+		int idx = (std::min)((int)pos, width - 2);
+		index[k] = idx;
+		weight[k] = 1.0f - (pos - (float)idx);
+	}
+
+	return true;
+}
+
+
+QString CrsTable::sidecarPath(const QString& path)
+{
+	QFileInfo info(path);
+	return info.path() + "/" + info.completeBaseName() + ".bin";
+}
+
+bool CrsTable::readSidecar(const QString& path, int64_t source_size, int64_t source_time, std::vector<int>& _raw_index, std::vector<float>& _raw_weight)
+{
+	QFile file(path);
+	if (false == file.open(QIODevice::ReadOnly))
+		return false;
+
+	Header header;
+	if ((file.read(reinterpret_cast<char*>(&header), sizeof(Header)) != sizeof(Header))
+		|| (header.magic != CRS_TABLE_MAGIC) || (header.version != CRS_TABLE_VERSION) || (header.length <= 0)
+		|| (header.source_size != source_size) || (header.source_time != source_time)
+		|| (file.size() != (qint64)(sizeof(Header) + header.length * (sizeof(int) + sizeof(float)))))
+		return false;
+
+	_raw_index.resize(header.length);
+	_raw_weight.resize(header.length);
+	qint64 n_index = sizeof(int) * header.length, n_weight = sizeof(float) * header.length;
+
+	return (file.read(reinterpret_cast<char*>(_raw_index.data()), n_index) == n_index)
+		&& (file.read(reinterpret_cast<char*>(_raw_weight.data()), n_weight) == n_weight);
+}
+
+bool CrsTable::readText(const QString& path, std::vector<int>& _raw_index, std::vector<float>& _raw_weight)
+{
+	QFile file(path);
+	if (false == file.open(QIODevice::ReadOnly))
+		return false;
+
+	QTextStream in(&file);
+	while (!in.atEnd())
+	{
+		QStringList comp_idx = in.readLine().split('\t');
+		if (comp_idx.size() < 2)
+			continue;
+
+		// Integer index & weight keeping the source position (index + 1 - weight)
+		float idx = comp_idx[0].toFloat();
+		int i = (int)floor(idx);
+		_raw_index.push_back(i);
+		_raw_weight.push_back(comp_idx[1].toFloat() - (idx - (float)i));
+	}
+
+	file.close();
+
+	return !_raw_index.empty();
+}
+
+bool CrsTable::writeSidecar(const QString& path, int64_t source_size, int64_t source_time, const std::vector<int>& _raw_index, const std::vector<float>& _raw_weight)
+{
+	QFile file(path);
+	if (false == file.open(QIODevice::WriteOnly))
+		return false;
+
+	Header header = { CRS_TABLE_MAGIC, CRS_TABLE_VERSION, (int32_t)_raw_index.size(), 0, source_size, source_time };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	file.write(reinterpret_cast<const char*>(_raw_index.data()), sizeof(int) * _raw_index.size());
+	file.write(reinterpret_cast<const char*>(_raw_weight.data()), sizeof(float) * _raw_weight.size());
+	file.close();
+
+	return true;
+}
@@ -0,0 +1,71 @@
+#ifndef CRS_TABLE_H
+#define CRS_TABLE_H
+
+#include <QString>
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+#define CRS_TABLE_MAGIC				0x31535243 // "CRS1"
+#define CRS_TABLE_VERSION			1
+
+
+// CRS nonlinearity compensation table: out(k) = weight(k) * line(index(k)) + (1 - weight(k)) * line(index(k) + 1).
+// The text file (index \t weight per raw pixel) is compiled once into an integer index & weight table,
+// cached in a binary sidecar (.bin next to the text file, rebuilt when the text file changes),
+// and resampled to the binned line width whenever nPixels or the binning changes (identity past the end of a shorter table).
+class CrsTable
+{
+public:
+	CrsTable();
+	virtual ~CrsTable();
+
+private: // Not to call copy constrcutor and copy assignment operator
+	CrsTable(const CrsTable&);
+	CrsTable& operator=(const CrsTable&);
+
+public:
+	// Raw table from the sidecar when up to date, otherwise from the text file (the sidecar rewritten)
+	bool load(const QString& path);
+
+	// Table of the binned line (nullptr from getIndex / getWeight when not covered), only recompiled on a change
+	// Called from one thread (the frame assembly), load may run concurrently
+	bool compile(int n_pixels, int binning);
+
+	inline const int* getIndex() const { return index.empty() ? nullptr : index.data(); }
+	inline const float* getWeight() const { return weight.empty() ? nullptr : weight.data(); }
+	inline int getWidth() const { return (int)index.size(); }
+	inline bool isFromSidecar() const { return from_sidecar; }
+
+private:
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		int32_t length;
+		int32_t reserved;
+		int64_t source_size; // text file size & modification time [msec since epoch]
+		int64_t source_time;
+	};
+
+	static QString sidecarPath(const QString& path);
+	bool readSidecar(const QString& path, int64_t source_size, int64_t source_time, std::vector<int>& raw_index, std::vector<float>& raw_weight);
+	bool readText(const QString& path, std::vector<int>& raw_index, std::vector<float>& raw_weight);
+	bool writeSidecar(const QString& path, int64_t source_size, int64_t source_time, const std::vector<int>& raw_index, const std::vector<float>& raw_weight);
+
+private:
+	// Raw pixels (guarded by mtx)
+	std::mutex mtx;
+	std::vector<int> raw_index;
+	std::vector<float> raw_weight;
+	int revision;
+	bool from_sidecar;
+
+	// Binned line
+	int n_pixels, binning, compiled_revision;
+	std::vector<int> index;
+	std::vector<float> weight;
+};
+
+#endif // CRS_TABLE_H
@@ -0,0 +1,195 @@
+
+#include "FrameAssembler.h"
+
+#include <cmath>
+
+#ifdef ASSEMBLER_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+
+// 8 output pixels per iteration: masked gathers of the taps (no load for the padding taps), returns the first pixel left
+AVX2_TARGET static int gather_avx2(const GatherTable& table, float* dst_intensity, float* dst_lifetime,
+	const float* sum_intensity, const float* sum_lifetime, const float* count, const float* weight_lifetime)
+{
+	const __m256 zero = _mm256_setzero_ps();
+
+	int x = 0;
+	for (; x + 8 <= table.width; x += 8)
+	{
+		__m256 intensity = zero, lifetime = zero;
+		for (int t = 0; t < table.max_taps; t++)
+		{
+			__m256i src = _mm256_loadu_si256((const __m256i*)(table.index.data() + t * table.width + x));
+			__m256 w = _mm256_loadu_ps(table.weight.data() + t * table.width + x);
+			__m256 valid = _mm256_cmp_ps(w, zero, _CMP_NEQ_OQ);
+
+			__m256 n = _mm256_mask_i32gather_ps(zero, count, src, valid, 4);
+			__m256 d = weight_lifetime ? _mm256_mask_i32gather_ps(zero, weight_lifetime, src, valid, 4) : n;
+			__m256 s_intensity = _mm256_mask_i32gather_ps(zero, sum_intensity, src, valid, 4);
+			__m256 s_lifetime = _mm256_mask_i32gather_ps(zero, sum_lifetime, src, valid, 4);
+
+			intensity = _mm256_fmadd_ps(_mm256_and_ps(valid, _mm256_div_ps(w, n)), s_intensity, intensity);
+			lifetime = _mm256_fmadd_ps(_mm256_and_ps(valid, _mm256_div_ps(w, d)), s_lifetime, lifetime);
+		}
+		_mm256_storeu_ps(dst_intensity + x, intensity);
+		_mm256_storeu_ps(dst_lifetime + x, lifetime);
+	}
+
+	return x;
+}
+#endif
+
+
+FrameAssembler::FrameAssembler() :
+	width(0), bidirectional(false), bidir_shift(0.0f), crs(false), avx2(cpuSupportsAvx2())
+{
+}
+
+FrameAssembler::~FrameAssembler()
+{
+}
+
+
+void FrameAssembler::prepare(int _width, bool _bidirectional, float _bidir_shift, const int* _crs_index, const float* _crs_weight)
+{
+	bool _crs = (_crs_index != nullptr) && (_crs_weight != nullptr);
+
+	bool changed = (_width != width) || (_bidirectional != bidirectional) || (_bidir_shift != bidir_shift) || (_crs != crs);
+	if (!changed && crs)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			if ((_crs_index[x] != crs_index[x]) || (_crs_weight[x] != crs_weight[x]))
+			{
+				changed = true;
+				break;
+			}
+		}
+	}
+	if (!changed)
+		return;
+
+	width = _width;
+	bidirectional = _bidirectional;
+	bidir_shift = _bidir_shift;
+	crs = _crs;
+	if (crs)
+	{
+		crs_index.assign(_crs_index, _crs_index + width);
+		crs_weight.assign(_crs_weight, _crs_weight + width);
+	}
+
+	build();
+}
+
+void FrameAssembler::operator()(float* dst_intensity, float* dst_lifetime, const float* sum_intensity, const float* sum_lifetime, const float* count,
+	int row0, int row1, const float* weight_lifetime) const
+{
+	tbb::parallel_for(tbb::blocked_range<int>(row0, row1, ASSEMBLER_ROW_GRAIN),
+		[&](const tbb::blocked_range<int>& r) {
+		for (int y = r.begin(); y != r.end(); ++y)
+		{
+			size_t offset = (size_t)y * width;
+			gather((bidirectional && (y % 2)) ? backward : forward, dst_intensity + offset, dst_lifetime + offset,
+				sum_intensity + offset, sum_lifetime + offset, count + offset, weight_lifetime ? weight_lifetime + offset : nullptr);
+		}
+	});
+}
+
+
+void FrameAssembler::build()
+{
+	forward.resize(width);
+	backward.resize(width);
+
+	// Line before the CRS warp: forward lines as acquired,
+	// backward lines flipped and shifted by bidir_shift with a linear interpolation (p = x - shift on the flipped line)
+	GatherTable line[2];
+	line[0].resize(width);
+	line[1].resize(width);
+
+	int s = (int)floor(-bidir_shift);
+	float f = -bidir_shift - (float)s;
+	for (int x = 0; x < width; x++)
+	{
+		line[0].add(x, x, 1.0f);
+
+		int i0 = x + s;
+		line[1].add(x, width - 1 - i0, 1.0f - f);
+		line[1].add(x, width - 1 - (i0 + 1), f);
+	}
+
+	// CRS warp: out(k) = w(k) * line(idx(k)) + (1 - w(k)) * line(idx(k) + 1), the last pixel kept
+	GatherTable* tables[2] = { &forward, &backward };
+	for (int d = 0; d < 2; d++)
+	{
+		for (int k = 0; k < width; k++)
+		{
+			int src[2] = { k, k };
+			float w[2] = { 1.0f, 0.0f };
+			if (crs && (k != width - 1))
+			{
+				src[0] = crs_index[k]; src[1] = src[0] + 1;
+				w[0] = crs_weight[k]; w[1] = 1.0f - crs_weight[k];
+			}
+
+			for (int i = 0; i < 2; i++)
+			{
+				if ((w[i] == 0.0f) || (src[i] < 0) || (src[i] >= width))
+					continue;
+				for (int t = 0; t < line[d].taps[src[i]]; t++)
+					tables[d]->add(k, line[d].src(src[i], t), w[i] * line[d].w(src[i], t));
+			}
+		}
+	}
+}
+
+void FrameAssembler::gather(const GatherTable& table, float* dst_intensity, float* dst_lifetime,
+	const float* sum_intensity, const float* sum_lifetime, const float* count, const float* weight_lifetime) const
+{
+	int x = 0;
+#ifdef ASSEMBLER_AVX2
+	if (avx2)
+		x = gather_avx2(table, dst_intensity, dst_lifetime, sum_intensity, sum_lifetime, count, weight_lifetime);
+#endif
+
+	// Scalar path (remainder of the vector path)
+	for (; x < width; x++)
+	{
+		float intensity = 0.0f, lifetime = 0.0f;
+		for (int t = 0; t < table.taps[x]; t++)
+		{
+			int src = table.src(x, t);
+			float w = table.w(x, t);
+			intensity += w / count[src] * sum_intensity[src]; // averaging over the valid samples
+			lifetime += w / (weight_lifetime ? weight_lifetime[src] : count[src]) * sum_lifetime[src];
+		}
+		dst_intensity[x] = intensity;
+		dst_lifetime[x] = lifetime;
+	}
+}
+
+bool FrameAssembler::cpuSupportsAvx2()
+{
+#ifdef ASSEMBLER_AVX2
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool fma = (info[2] & (1 << 12)) != 0, osxsave = (info[2] & (1 << 27)) != 0;
+	if (!fma || !osxsave || ((_xgetbv(0) & 0x6) != 0x6)) // YMM state saved by the OS
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,110 @@
+#ifndef FRAME_ASSEMBLER_H
+#define FRAME_ASSEMBLER_H
+
+#include <vector>
+#include <algorithm>
+
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+#define ASSEMBLER_MAX_TAPS			4 // CRS warp (2 taps) of the sub-pixel shifted backward line (2 taps)
+#define ASSEMBLER_ROW_GRAIN			8 // rows per task of the gather pass
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define ASSEMBLER_AVX2				// AVX2 gather / FMA kernel, selected at run time
+#endif
+
+
+// Gather table of one scan direction: for each output pixel, the source pixels of the raw line and their weights.
+// Tap-major (a row of 8 pixels per vector load), the taps past taps[x] have a zero weight.
+struct GatherTable
+{
+	int width = 0;
+	int max_taps = 0; // over the line
+	std::vector<int> taps; // taps of the output pixel (0 ~ ASSEMBLER_MAX_TAPS)
+	std::vector<int> index; // [t * width + x]: source pixel
+	std::vector<float> weight; // [t * width + x]
+
+	void resize(int _width)
+	{
+		width = _width;
+		max_taps = 0;
+		taps.assign(width, 0);
+		index.assign(width * ASSEMBLER_MAX_TAPS, 0);
+		weight.assign(width * ASSEMBLER_MAX_TAPS, 0.0f);
+	}
+
+	inline int src(int x, int t) const { return index[t * width + x]; }
+	inline float w(int x, int t) const { return weight[t * width + x]; }
+
+	// Merged with an existing tap of the same source pixel, zero weights & out-of-line pixels skipped
+	void add(int x, int src, float w)
+	{
+		if ((w == 0.0f) || (src < 0) || (src >= width))
+			return;
+
+		for (int t = 0; t < taps[x]; t++)
+		{
+			if (index[t * width + x] == src)
+			{
+				weight[t * width + x] += w;
+				return;
+			}
+		}
+		if (taps[x] < ASSEMBLER_MAX_TAPS)
+		{
+			index[taps[x] * width + x] = src;
+			weight[taps[x] * width + x] = w;
+			taps[x]++;
+			max_taps = (std::max)(max_taps, taps[x]);
+		}
+	}
+};
+
+
+// Assembly of the FLIm images in one gather pass per output row (a whole frame or each line as it completes):
+// averaging by the valid sample count, bidirectional flip & sub-pixel shift of the backward lines and CRS warp
+// are folded into one table per scan direction, applied to intensity and lifetime at once (8 pixels per AVX2 gather when supported).
+class FrameAssembler
+{
+public:
+	FrameAssembler();
+	virtual ~FrameAssembler();
+
+private: // Not to call copy constrcutor and copy assignment operator
+	FrameAssembler(const FrameAssembler&);
+	FrameAssembler& operator=(const FrameAssembler&);
+
+public:
+	// Rebuild the tables when the line width or a compensation parameter changed (otherwise only a comparison)
+	// bidir_shift: shift of the backward lines [pixel], crs_index & crs_weight: width entries (CrsTable) or nullptr (no CRS warp)
+	void prepare(int width, bool bidirectional, float bidir_shift, const int* crs_index, const float* crs_weight);
+
+	// Output rows [row0, row1) of one channel: dst(x, y) = sum of w * sum(src, y) / count(src, y) over the taps.
+	// The sources are the accumulated lines of the output rows (stride: width), a pixel without valid sample gives NaN / inf.
+	// weight_lifetime: denominator of the lifetime instead of count (intensity-weighted averages), nullptr: count
+	void operator()(float* dst_intensity, float* dst_lifetime, const float* sum_intensity, const float* sum_lifetime, const float* count,
+		int row0, int row1, const float* weight_lifetime = nullptr) const;
+
+	inline int getWidth() const { return width; }
+	inline bool isVectorized() const { return avx2; }
+
+private:
+	void build();
+	void gather(const GatherTable& table, float* dst_intensity, float* dst_lifetime,
+		const float* sum_intensity, const float* sum_lifetime, const float* count, const float* weight_lifetime) const;
+	static bool cpuSupportsAvx2();
+
+private:
+	int width;
+	bool bidirectional;
+	float bidir_shift;
+	bool crs;
+	std::vector<int> crs_index;
+	std::vector<float> crs_weight;
+	bool avx2;
+
+	GatherTable forward, backward; // even & odd output rows
+};
+
+#endif // FRAME_ASSEMBLER_H
@@ -0,0 +1,195 @@
+
+#include "FrameAverager.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+
+FrameAverager::FrameAverager() :
+	width(0), lines(0), mode(AVERAGING_BLOCK), window(1), alpha(1.0f), frames(0), slot(0), restart_requested(false)
+{
+}
+
+FrameAverager::~FrameAverager()
+{
+}
+
+
+void FrameAverager::beginFrame(int _width, int _lines, int _mode, int _frames, float _alpha, bool first_of_block)
+{
+	int _window = (std::max)(_frames, 1);
+
+	// Layout: new accumulators
+	bool changed = (_width != width) || (_lines != lines) || (_mode != mode) || ((_mode == AVERAGING_SLIDING) && (_window != window));
+	width = _width;
+	lines = _lines;
+	mode = _mode;
+	window = _window;
+	alpha = (_alpha > 0.0f) ? (std::min)(_alpha, 1.0f) : 2.0f / (float)(window + 1);
+	if (changed)
+		allocate();
+
+	// New average
+	bool restarted = restart_requested.exchange(false);
+	if (changed || restarted || ((mode == AVERAGING_BLOCK) && first_of_block))
+	{
+		if (!changed)
+			clear();
+		frames = 0;
+	}
+
+	slot = frames % window;
+	frames++;
+}
+
+void FrameAverager::accumulate(const np::FloatView2& intensity, const np::FloatView2& lifetime, int _offset, int n, float threshold)
+{
+	tbb::parallel_for(tbb::blocked_range<int>(0, AVERAGING_CHANNELS),
+		[&](const tbb::blocked_range<int>& r) {
+		for (int ch = r.begin(); ch != r.end(); ++ch)
+		{
+			size_t k0 = offset(ch, 0) + _offset;
+			const float* in_intensity = &intensity(0, ch + 1);
+			const float* in_lifetime = &lifetime(0, ch);
+
+			float* s_intensity = sum_intensity.raw_ptr() + k0;
+			float* s_lifetime = sum_lifetime.raw_ptr() + k0;
+			float* s_count = count.raw_ptr() + k0;
+
+			if (mode == AVERAGING_BLOCK)
+			{
+				for (int j = 0; j < n; j++)
+				{
+					s_intensity[j] += in_intensity[j];
+					s_lifetime[j] += in_lifetime[j];
+					if (in_intensity[j] > threshold)
+						s_count[j] += 1.0f;
+				}
+			}
+			else if (mode == AVERAGING_EXPONENTIAL)
+			{
+				// Numerators & denominators decay alike: their ratio is the exponentially weighted average
+				float* s_weight = weight_lifetime.raw_ptr() + k0;
+				float a = alpha, b = 1.0f - alpha;
+				for (int j = 0; j < n; j++)
+				{
+					float i = in_intensity[j], tau = in_lifetime[j];
+					bool valid = i > threshold;
+					bool valid_tau = valid && std::isfinite(tau);
+
+					s_intensity[j] = b * s_intensity[j] + a * i;
+					s_count[j] = b * s_count[j] + (valid ? a : 0.0f);
+					s_lifetime[j] = b * s_lifetime[j] + (valid_tau ? a * i * tau : 0.0f);
+					s_weight[j] = b * s_weight[j] + (valid_tau ? a * i : 0.0f);
+				}
+			}
+			else // AVERAGING_SLIDING
+			{
+				// Running sums: the frame leaving the window (previous content of the slot) out, the current frame in
+				// (non-finite samples are stored as 0: nothing sticks to the sums)
+				float* r_intensity = ring_intensity.at(slot).raw_ptr() + k0;
+				float* r_lifetime = ring_lifetime.at(slot).raw_ptr() + k0;
+				uint8_t* r_valid = ring_valid.at(slot).raw_ptr() + k0;
+				float* s_weight = weight_lifetime.raw_ptr() + k0;
+				for (int j = 0; j < n; j++)
+				{
+					float i = in_intensity[j], tau = in_lifetime[j];
+					if (!std::isfinite(i)) i = 0.0f;
+					uint8_t valid = (i > threshold) ? VALID_INTENSITY : 0;
+					if (valid && std::isfinite(tau)) valid |= VALID_LIFETIME;
+					float i_tau = (valid & VALID_LIFETIME) ? i * tau : 0.0f;
+
+					float i_old = r_intensity[j];
+					uint8_t valid_old = r_valid[j];
+					s_intensity[j] += i - i_old;
+					s_lifetime[j] += i_tau - r_lifetime[j];
+					s_count[j] += (float)(valid & VALID_INTENSITY) - (float)(valid_old & VALID_INTENSITY);
+					s_weight[j] += ((valid & VALID_LIFETIME) ? i : 0.0f) - ((valid_old & VALID_LIFETIME) ? i_old : 0.0f);
+
+					r_intensity[j] = i;
+					r_lifetime[j] = i_tau;
+					r_valid[j] = valid;
+				}
+
+				// Rounding of the running sums: a 1 / window share of the samples recomputed over the ring at every frame
+				// (every sample once per window length, about n additions per piece whatever the window)
+				int share = (n + window - 1) / window;
+				int j0 = (std::min)(slot * share, n);
+				resum(k0 + j0, (std::min)(share, n - j0));
+			}
+		}
+	});
+}
+
+
+void FrameAverager::resum(size_t k0, int n)
+{
+	float* s_intensity = sum_intensity.raw_ptr() + k0;
+	float* s_lifetime = sum_lifetime.raw_ptr() + k0;
+	float* s_count = count.raw_ptr() + k0;
+	float* s_weight = weight_lifetime.raw_ptr() + k0;
+	memset(s_intensity, 0, sizeof(float) * n);
+	memset(s_lifetime, 0, sizeof(float) * n);
+	memset(s_count, 0, sizeof(float) * n);
+	memset(s_weight, 0, sizeof(float) * n);
+	for (int s = 0; s < window; s++)
+	{
+		const float* f_intensity = ring_intensity.at(s).raw_ptr() + k0;
+		const float* f_lifetime = ring_lifetime.at(s).raw_ptr() + k0;
+		const uint8_t* f_valid = ring_valid.at(s).raw_ptr() + k0;
+		for (int j = 0; j < n; j++)
+		{
+			s_intensity[j] += f_intensity[j];
+			s_lifetime[j] += f_lifetime[j];
+			s_count[j] += (f_valid[j] & VALID_INTENSITY) ? 1.0f : 0.0f;
+			s_weight[j] += (f_valid[j] & VALID_LIFETIME) ? f_intensity[j] : 0.0f;
+		}
+	}
+}
+
+void FrameAverager::allocate()
+{
+	int height = AVERAGING_CHANNELS * lines;
+
+	sum_intensity = np::FloatArray2(width, height);
+	sum_lifetime = np::FloatArray2(width, height);
+	count = np::FloatArray2(width, height);
+	weight_lifetime = (mode == AVERAGING_BLOCK) ? np::FloatArray2() : np::FloatArray2(width, height);
+
+	std::vector<np::FloatArray2> clear_intensity, clear_lifetime;
+	std::vector<np::Uint8Array2> clear_valid;
+	clear_intensity.swap(ring_intensity);
+	clear_lifetime.swap(ring_lifetime);
+	clear_valid.swap(ring_valid);
+	if (mode == AVERAGING_SLIDING)
+	{
+		for (int s = 0; s < window; s++)
+		{
+			ring_intensity.push_back(np::FloatArray2(width, height));
+			ring_lifetime.push_back(np::FloatArray2(width, height));
+			ring_valid.push_back(np::Uint8Array2(width, height));
+		}
+	}
+
+	clear();
+}
+
+void FrameAverager::clear()
+{
+	memset(sum_intensity.raw_ptr(), 0, sizeof(float) * sum_intensity.length());
+	memset(sum_lifetime.raw_ptr(), 0, sizeof(float) * sum_lifetime.length());
+	memset(count.raw_ptr(), 0, sizeof(float) * count.length());
+	if (weight_lifetime.length())
+		memset(weight_lifetime.raw_ptr(), 0, sizeof(float) * weight_lifetime.length());
+
+	for (int s = 0; s < (int)ring_valid.size(); s++)
+	{
+		memset(ring_intensity.at(s).raw_ptr(), 0, sizeof(float) * ring_intensity.at(s).length());
+		memset(ring_lifetime.at(s).raw_ptr(), 0, sizeof(float) * ring_lifetime.at(s).length());
+		memset(ring_valid.at(s).raw_ptr(), 0, sizeof(uint8_t) * ring_valid.at(s).length());
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef FRAME_AVERAGER_H
+#define FRAME_AVERAGER_H
+
+#include <vector>
+#include <atomic>
+
+#include <Common/array.h>
+
+#define AVERAGING_BLOCK				0 // N frames summed, restarted after each average
+#define AVERAGING_EXPONENTIAL		1 // exponential moving average (alpha)
+#define AVERAGING_SLIDING			2 // last N frames (ring of per-frame lines, running sums)
+
+#define AVERAGING_CHANNELS			3
+
+#define VALID_INTENSITY				0x01 // sample above the intensity threshold
+#define VALID_LIFETIME				0x02 // ... with a finite lifetime
+
+
+// Accumulated FLIm lines of the averaged frames (3 channels of lines x width samples), read by FrameAssembler:
+// intensity = sum / count, lifetime = sum / count (block) or intensity-weighted sum / weight (running modes).
+// The running modes give an average of the latest frames at every frame; the block mode one average every N frames.
+// Sliding window: running sums (frame in, frame out), so the cost per piece does not depend on the window length.
+class FrameAverager
+{
+public:
+	FrameAverager();
+	virtual ~FrameAverager();
+
+private: // Not to call copy constrcutor and copy assignment operator
+	FrameAverager(const FrameAverager&);
+	FrameAverager& operator=(const FrameAverager&);
+
+public:
+	// Start of a frame: new accumulators on a layout or mode change, after restart(), and in block mode at the first frame of an average
+	// alpha: weight of the new frame (exponential mode, <= 0: 2 / (frames + 1))
+	void beginFrame(int width, int lines, int mode, int frames, float alpha, bool first_of_block);
+
+	// The next frame starts a new average (acquisition start, stage moved), callable from any thread
+	void restart() { restart_requested = true; }
+
+	// Samples [offset, offset + n) of the channel lines: intensity rows 1 ~ 3, lifetime rows 0 ~ 2
+	void accumulate(const np::FloatView2& intensity, const np::FloatView2& lifetime, int offset, int n, float threshold);
+
+public:
+	// Channel lines from the line (stride: width)
+	inline const float* getIntensity(int ch, int line) const { return sum_intensity.raw_ptr() + offset(ch, line); }
+	inline const float* getLifetime(int ch, int line) const { return sum_lifetime.raw_ptr() + offset(ch, line); }
+	inline const float* getCount(int ch, int line) const { return count.raw_ptr() + offset(ch, line); }
+	inline const float* getLifetimeWeight(int ch, int line) const { return (mode == AVERAGING_BLOCK) ? nullptr : weight_lifetime.raw_ptr() + offset(ch, line); }
+
+	inline int getMode() const { return mode; }
+	inline int getFrames() const { return frames; } // frames since the last restart
+
+private:
+	inline size_t offset(int ch, int line) const { return ((size_t)ch * lines + line) * width; }
+
+	void allocate();
+	void clear();
+	void resum(size_t k0, int n); // sliding window: sums of samples [k0, k0 + n) recomputed over the ring
+
+private:
+	int width, lines, mode, window;
+	float alpha;
+	int frames, slot;
+	std::atomic<bool> restart_requested;
+
+	np::FloatArray2 sum_intensity, sum_lifetime, count, weight_lifetime;
+
+	// Sliding window: per-frame intensity, intensity-weighted lifetime & VALID_ flags
+	std::vector<np::FloatArray2> ring_intensity, ring_lifetime;
+	std::vector<np::Uint8Array2> ring_valid;
+};
+
+#endif // FRAME_AVERAGER_H
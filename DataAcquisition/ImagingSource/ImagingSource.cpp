@@ -1,11 +1,15 @@
 
 #include "ImagingSource.h"
 
+#include <Common/ThreadPlacement.h>
+#include <Common/RealTime.h>
+#include <Common/Tracer.h>
+
 #define NUM_IMAGING_SOURCE_BUFFERS	20
 
 
 ImagingSource::ImagingSource() :
-	m_pGrabber(nullptr), m_pGainAbsolute(NULL), m_pExposureAbsolute(NULL), _dirty(true)
+	placement(nullptr), m_pGrabber(nullptr), m_pGainAbsolute(NULL), m_pExposureAbsolute(NULL), _dirty(true)
 {
 }
 
@@ -63,11 +67,10 @@ bool ImagingSource::startAcquisition()
     }
 
     _thread = std::thread(&ImagingSource::run, this); // thread executing
-    if (::SetThreadPriority(_thread.native_handle(), THREAD_PRIORITY_TIME_CRITICAL) == 0)
-    {
-        cout << "ERROR: Failed to set acquisition thread priority: " << endl;
-        return false;
-    }
+    if (!RealTime::setPriority(_thread, placement ? placement->priority : RT_PRIORITY_CRITICAL))
+        cout << "WARNING: Failed to set real-time acquisition thread priority" << endl;
+    if (placement && !placement->pin(_thread))
+        cout << "WARNING: Failed to set acquisition thread affinity" << endl;
 
     SendStatusMessage("Video capturing thread is started.", false);
 
@@ -216,6 +219,7 @@ void ImagingSource::run()
 		}
 
 		// Copy frame data and send to callback function
+		TRACE_SCOPE("CMOS callback");
 		np::Uint16Array2 frame(info.dim.cx, info.dim.cy);
 		memcpy(frame.raw_ptr(), (uint16_t*)lst.at(imageCnt % NUM_IMAGING_SOURCE_BUFFERS).get()->getPtr(), sizeof(uint16_t) * frame.length());
 		DidAcquireData(imageCnt % 4, frame);
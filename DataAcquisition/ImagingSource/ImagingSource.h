@@ -10,6 +10,8 @@
 #include <Common/array.h>
 #include <Common/callback.h>
 
+class StagePlacement;
+
 using namespace DShowLib;
 using namespace std;
 using namespace np;
@@ -49,6 +51,8 @@ public:
     bool _running;
 	std::mutex mutex_;
 
+	StagePlacement* placement; // cpu set of the capturing thread (nullptr: any)
+
 private:
 	Grabber* m_pGrabber;
 	
@@ -0,0 +1,100 @@
+
+#include "Pipeline.h"
+
+#include <DataAcquisition/ThreadManager.h>
+
+
+PipelineStage::PipelineStage(const char* _name, int n_threads, StagePlacement* placement) :
+	name(_name)
+{
+	for (int i = 0; i < n_threads; i++)
+	{
+		char thread_id[MAX_LENGTH];
+		if (n_threads == 1)
+			sprintf(thread_id, "%s", _name);
+		else
+			sprintf(thread_id, "%s %d", _name, i);
+
+		ThreadManager* pThread = new ThreadManager(thread_id);
+		pThread->placement = placement;
+		threads.push_back(pThread);
+	}
+}
+
+PipelineStage::~PipelineStage()
+{
+	for (ThreadManager* pThread : threads)
+		delete pThread;
+}
+
+
+void PipelineStage::start()
+{
+	for (ThreadManager* pThread : threads)
+		pThread->startThreading();
+}
+
+void PipelineStage::stop()
+{
+	for (ThreadManager* pThread : threads)
+		pThread->stopThreading();
+}
+
+
+Pipeline::Pipeline(const char* _name) :
+	name(_name)
+{
+}
+
+Pipeline::~Pipeline()
+{
+	for (PipelineStage* pStage : stages)
+		delete pStage;
+	for (PipelineEdgeBase* pEdge : edges)
+		delete pEdge;
+}
+
+
+void Pipeline::start()
+{
+	flush();
+	resetStats();
+
+	for (auto it = stages.rbegin(); it != stages.rend(); ++it)
+		(*it)->start();
+}
+
+void Pipeline::stop()
+{
+	// The source normally closes its edge when the acquisition stops
+	if (!edges.empty())
+		edges.front()->close();
+
+	for (PipelineStage* pStage : stages)
+		pStage->stop();
+}
+
+void Pipeline::flush()
+{
+	for (PipelineEdgeBase* pEdge : edges)
+		pEdge->flush();
+}
+
+void Pipeline::resetStats()
+{
+	for (PipelineEdgeBase* pEdge : edges)
+		pEdge->resetStats();
+	monitor.reset();
+}
+
+
+void Pipeline::addStage(PipelineStage* pStage)
+{
+	for (ThreadManager* pThread : pStage->threads)
+	{
+		pThread->SendStatusMessage += [&](const char* msg, bool is_error) {
+			SendStatusMessage(msg, is_error);
+		};
+	}
+	stages.push_back(pStage);
+}
@@ -0,0 +1,401 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+#include <Common/SyncObject.h>
+#include <Common/FrameDescriptor.h>
+#include <Common/callback.h>
+#include <Common/Tracer.h>
+
+#include <DataAcquisition/ThreadManager.h>
+
+class StagePlacement;
+
+
+// Buffer pool between two stages: one lane (SyncObject) per worker of the consuming stage.
+// Items are numbered in dispatch order; takeOrdered() restores that order after a multi-worker stage.
+class PipelineEdgeBase
+{
+public:
+	explicit PipelineEdgeBase(const char* _name) : name(_name) {}
+	virtual ~PipelineEdgeBase() {}
+
+public:
+	virtual void close() = 0; // any thread: stop sentinel on every lane
+	virtual void flush() = 0; // not thread safe: return the buffers left in flight & re-arm the lanes
+	virtual void resetStats() = 0;
+	virtual SyncStats stats() const = 0; // summed over the lanes
+	virtual size_t freeBuffers() const = 0;
+
+public:
+	std::string name;
+};
+
+template <typename T>
+class PipelineEdge : public PipelineEdgeBase
+{
+public:
+	PipelineEdge(const char* _name, int width, int height, int n_buffers, int n_lanes, int policy)
+		: PipelineEdgeBase(_name), dispatched(0), expected(0)
+	{
+		// The buffers are split over the lanes
+		int n_lane_buffers = (n_lanes == 1) ? n_buffers : (std::max)(n_buffers / n_lanes, 8);
+		for (int i = 0; i < n_lanes; i++)
+		{
+			vecLanes.push_back(new SyncObject<T>);
+			vecLanes.back()->allocate_queue_buffer(width, height, n_lane_buffers);
+			vecLanes.back()->policy = policy;
+		}
+		vecPending.resize(n_lanes);
+		vecClosed.assign(n_lanes, false);
+	}
+
+	virtual ~PipelineEdge()
+	{
+		for (SyncObject<T>* pLane : vecLanes) delete pLane;
+	}
+
+private: // Not to call copy constrcutor and copy assignment operator
+	PipelineEdge(const PipelineEdge&);
+	PipelineEdge& operator=(const PipelineEdge&);
+
+public:
+	inline int lanes() const { return (int)vecLanes.size(); }
+	inline SyncObject<T>& lane(int i) { return *vecLanes.at(i); }
+
+	// Source (single thread): free buffer of the next lane in round-robin order (nullptr: dropped)
+	T* acquire(int* lane)
+	{
+		*lane = (int)(dispatched % vecLanes.size());
+		return vecLanes.at(*lane)->acquire();
+	}
+
+	// Source: never waits, the lane queue may also hold lent buffers (false: queue full, dropped & the buffer back to the pool)
+	bool post(int lane, T* buffer, const FrameDescriptor& desc)
+	{
+		if (!vecLanes.at(lane)->try_post(buffer, dispatched, &desc))
+			return false;
+		dispatched++;
+		return true;
+	}
+
+	// Source: buffer of its own memory (desc.lease >= 0) in place of a pool buffer, handed back through returnLease
+	// (false: the lane queue is full, the lease is still the caller's)
+	bool lend(T* buffer, const FrameDescriptor& desc)
+	{
+		if (!vecLanes.at(dispatched % vecLanes.size())->lend(buffer, dispatched, &desc))
+			return false;
+		dispatched++;
+		return true;
+	}
+
+	// Consumer (single thread): next buffer in dispatch order over all lanes (nullptr: stop)
+	// Buffer k travels on lane k % n_lanes and each lane keeps its order:
+	// wait on the lane owning the expected sequence number, and skip the numbers dropped on the way.
+	// A closed lane only ends its own numbers: the other lanes are drained up to their last item before the stop.
+	T* takeOrdered(int* lane, FrameDescriptor* desc = nullptr)
+	{
+		int n_lanes = (int)vecLanes.size();
+		while (true)
+		{
+			int w = (int)(expected % n_lanes);
+			SyncItem<T>& pending = vecPending.at(w);
+			if ((pending.buffer == nullptr) && !vecClosed.at(w))
+			{
+				pending.buffer = vecLanes.at(w)->take(&pending.seq, &pending.desc);
+				if (pending.buffer == nullptr)
+					vecClosed.at(w) = true;
+			}
+
+			if (pending.buffer == nullptr)
+			{
+				// Closed lane: stop once every lane is closed & drained, otherwise its number is skipped
+				bool drained = true;
+				for (int i = 0; i < n_lanes; i++)
+					drained = drained && vecClosed.at(i) && (vecPending.at(i).buffer == nullptr);
+				if (drained)
+					return nullptr; // stop
+
+				expected++;
+				continue;
+			}
+
+			if (pending.seq == expected++)
+			{
+				T* buffer = pending.buffer;
+				pending.buffer = nullptr;
+				*lane = w;
+				if (desc) *desc = pending.desc;
+				return buffer;
+			}
+		}
+	}
+
+	// Consumer: pool buffers go back to their lane, lent buffers to the source
+	void release(int lane, T* buffer, int lease = -1)
+	{
+		if (lease < 0)
+			vecLanes.at(lane)->release(buffer);
+		else if (returnLease)
+			returnLease(lease);
+	}
+
+	void close()
+	{
+		for (SyncObject<T>* pLane : vecLanes)
+			pLane->Queue_sync.close();
+	}
+
+	void flush()
+	{
+		for (int w = 0; w < (int)vecLanes.size(); w++)
+		{
+			if (vecPending.at(w).buffer)
+				release(w, vecPending.at(w).buffer, vecPending.at(w).desc.lease);
+			vecPending.at(w) = SyncItem<T>();
+
+			SyncItem<T> item;
+			while (vecLanes.at(w)->Queue_sync.try_pop(item))
+				if (item.buffer) release(w, item.buffer, item.desc.lease);
+			vecLanes.at(w)->reset();
+			vecClosed.at(w) = false;
+		}
+		dispatched = 0;
+		expected = 0;
+	}
+
+	void resetStats()
+	{
+		for (SyncObject<T>* pLane : vecLanes)
+			pLane->resetStats();
+	}
+
+	SyncStats stats() const
+	{
+		SyncStats total;
+		for (SyncObject<T>* pLane : vecLanes)
+		{
+			SyncStats s = pLane->stats();
+			total.offered += s.offered; total.accepted += s.accepted; total.dropped += s.dropped;
+			total.depth += s.depth; total.high_water += s.high_water; total.capacity += s.capacity;
+			total.blocked_msec += s.blocked_msec;
+			total.starved_msec = (std::max)(total.starved_msec, s.starved_msec);
+		}
+		return total;
+	}
+
+	size_t freeBuffers() const
+	{
+		size_t size = 0;
+		for (SyncObject<T>* pLane : vecLanes)
+			size += pLane->queue_buffer.size();
+		return size;
+	}
+
+public:
+	std::function<void(int lease)> returnLease; // lent buffer released by the consumer (any thread)
+
+private:
+	std::vector<SyncObject<T>*> vecLanes;
+	uint64_t dispatched; // source thread
+	uint64_t expected; // ordered consumer thread
+	std::vector<SyncItem<T>> vecPending; // ordered consumer thread
+	std::vector<bool> vecClosed; // ordered consumer thread: stop sentinel taken from the lane
+};
+
+
+// Stage: one or more ThreadManager threads on a placement (cpu set & TBB arena)
+class PipelineStage
+{
+public:
+	PipelineStage(const char* _name, int n_threads, StagePlacement* placement);
+	virtual ~PipelineStage();
+
+private: // Not to call copy constrcutor and copy assignment operator
+	PipelineStage(const PipelineStage&);
+	PipelineStage& operator=(const PipelineStage&);
+
+public:
+	void start();
+	void stop();
+
+public:
+	std::string name;
+	std::vector<ThreadManager*> threads;
+};
+
+// Transform: buffer of input lane w -> body -> buffer of output lane w (one thread per lane, same sequence number & descriptor)
+// The input buffer is returned also when the output is dropped.
+// Each worker closes its output lane itself once its input lane is closed & drained.
+template <typename In, typename Out>
+class PipelineTransform : public PipelineStage
+{
+public:
+	typedef std::function<void(int worker, In* in, Out* out)> BODY;
+
+	PipelineTransform(const char* _name, PipelineEdge<In>* in, PipelineEdge<Out>* out, const BODY& body, StagePlacement* placement);
+
+public:
+	callback<int> DidDrain; // worker thread, after its last body call (before its output lane is closed)
+};
+
+// Sink: one thread consuming the input edge in dispatch order, end-to-end accounting of the descriptors in the monitor
+template <typename In>
+class PipelineSink : public PipelineStage
+{
+public:
+	typedef std::function<void(const FrameDescriptor& desc, In* in)> BODY;
+
+	PipelineSink(const char* _name, PipelineEdge<In>* in, const BODY& body, FrameMonitor* monitor, StagePlacement* placement);
+};
+
+
+// Stage graph of one modality: the source (acquisition callback) feeds the first edge,
+// transforms & sinks are declared in upstream-to-downstream order.
+class Pipeline
+{
+public:
+	explicit Pipeline(const char* _name);
+	virtual ~Pipeline();
+
+private: // Not to call copy constrcutor and copy assignment operator
+	Pipeline(const Pipeline&);
+	Pipeline& operator=(const Pipeline&);
+
+public:
+	template <typename T>
+	PipelineEdge<T>* addEdge(const char* edge_name, int width, int height, int n_buffers, int n_lanes = 1, int policy = SYNC_POLICY_DROP_NEWEST)
+	{
+		PipelineEdge<T>* pEdge = new PipelineEdge<T>(edge_name, width, height, n_buffers, n_lanes, policy);
+		edges.push_back(pEdge);
+		return pEdge;
+	}
+
+	template <typename In, typename Out>
+	PipelineTransform<In, Out>* addTransform(const char* stage_name, PipelineEdge<In>* in, PipelineEdge<Out>* out,
+		const typename PipelineTransform<In, Out>::BODY& body, StagePlacement* placement = nullptr)
+	{
+		PipelineTransform<In, Out>* pStage = new PipelineTransform<In, Out>(stage_name, in, out, body, placement);
+		addStage(pStage);
+		return pStage;
+	}
+
+	template <typename In>
+	PipelineSink<In>* addSink(const char* stage_name, PipelineEdge<In>* in,
+		const typename PipelineSink<In>::BODY& body, StagePlacement* placement = nullptr)
+	{
+		PipelineSink<In>* pStage = new PipelineSink<In>(stage_name, in, body, &monitor, placement);
+		addStage(pStage);
+		return pStage;
+	}
+
+public:
+	void start(); // flush the edges, reset the statistics & the monitor, start the stages (downstream first)
+	void stop(); // close the source edge, stop the stages (upstream first)
+	void flush();
+	void resetStats();
+
+	inline const std::vector<PipelineEdgeBase*>& getEdges() const { return edges; }
+	inline const std::vector<PipelineStage*>& getStages() const { return stages; }
+
+private:
+	void addStage(PipelineStage* pStage);
+
+public:
+	std::string name;
+	callback2<const char*, bool> SendStatusMessage;
+	FrameMonitor monitor; // frames reaching the sinks
+
+private:
+	std::vector<PipelineEdgeBase*> edges;
+	std::vector<PipelineStage*> stages;
+};
+
+
+template <typename In, typename Out>
+PipelineTransform<In, Out>::PipelineTransform(const char* _name, PipelineEdge<In>* in, PipelineEdge<Out>* out, const BODY& body, StagePlacement* placement)
+	: PipelineStage(_name, in->lanes(), placement)
+{
+	const char* span = name.c_str(); // trace span of the body (lives with the stage)
+	for (int w = 0; w < (int)threads.size(); w++)
+	{
+		ThreadManager* pThread = threads.at(w);
+
+		pThread->DidAcquireData += [this, pThread, in, out, body, w, span](int frame_count) {
+
+			// Get the buffer from the previous sync Queue
+			uint64_t seq;
+			FrameDescriptor desc;
+			In* in_data = in->lane(w).take(&seq, &desc);
+			if (in_data != nullptr)
+			{
+				int lease = desc.lease;
+				desc.lease = -1; // the output buffer belongs to the output edge
+
+				// Get buffer from the next threading queue
+				Out* out_ptr = out->lane(w).acquire();
+				if (out_ptr != nullptr)
+				{
+					{
+						TRACE_SCOPE(span);
+						body(w, in_data, out_ptr);
+					}
+					desc.stamp();
+
+					// Push the buffer to the next sync Queue (same sequence number)
+					out->lane(w).post(out_ptr, seq, &desc);
+				}
+
+				// Return (push) the buffer to the previous threading queue (or to the source that lent it)
+				in->release(w, in_data, lease);
+			}
+			else
+			{
+				// Input lane closed & drained: close the output lane behind the last posted buffer
+				DidDrain(w);
+				out->lane(w).Queue_sync.close();
+				pThread->_running = false;
+			}
+
+			(void)frame_count;
+		};
+	}
+}
+
+template <typename In>
+PipelineSink<In>::PipelineSink(const char* _name, PipelineEdge<In>* in, const BODY& body, FrameMonitor* monitor, StagePlacement* placement)
+	: PipelineStage(_name, 1, placement)
+{
+	ThreadManager* pThread = threads.front();
+	const char* span = name.c_str(); // trace span of the body (lives with the stage)
+
+	pThread->DidAcquireData += [pThread, in, body, monitor, span](int frame_count) {
+
+		// Get the buffer from the previous sync Queues (in dispatch order)
+		int lane;
+		FrameDescriptor desc;
+		In* in_data = in->takeOrdered(&lane, &desc);
+		if (in_data != nullptr)
+		{
+			{
+				TRACE_SCOPE(span);
+				body(desc, in_data);
+			}
+			desc.stamp();
+			monitor->record(desc);
+
+			// Return (push) the buffer to the previous threading queue (or to the source that lent it)
+			in->release(lane, in_data, desc.lease);
+		}
+		else
+			pThread->_running = false;
+
+		(void)frame_count;
+	};
+}
+
+#endif // PIPELINE_H
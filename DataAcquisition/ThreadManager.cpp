@@ -1,9 +1,12 @@
 
 #include "ThreadManager.h"
 
+#include <Common/ThreadPlacement.h>
+#include <Common/Tracer.h>
+
 
 ThreadManager::ThreadManager(const char* _threadID) :
-    _running(false)
+    _running(false), placement(nullptr)
 {
 	memset(threadID, 0, MAX_LENGTH);
 	memcpy(threadID, _threadID, strlen(_threadID));
@@ -23,9 +26,26 @@ void ThreadManager::run()
 {
     unsigned int frameIndex = 0;
 
+    TRACE_THREAD_NAME(threadID);
+
     _running = true;
-    while (_running)
-        DidAcquireData(frameIndex++);
+    auto loop = [&]() {
+        while (_running)
+            DidAcquireData(frameIndex++);
+    };
+
+    if (placement)
+    {
+        if (!placement->enter())
+        {
+            char msg[256];
+            sprintf(msg, "[%s] WARNING: Failed to apply the thread placement (cpus / %s priority).", threadID, RealTime::priorityName(placement->priority));
+            SendStatusMessage(msg, false);
+        }
+        placement->execute(loop);
+    }
+    else
+        loop();
 }
 
 bool ThreadManager::startThreading()
@@ -9,6 +9,8 @@
 
 #define MAX_LENGTH 2000
 
+class StagePlacement;
+
 class ThreadManager
 {
 public:
@@ -27,6 +29,7 @@ private:
 
 public:
     bool _running;
+    StagePlacement* placement; // cpu set & TBB arena of the thread (nullptr: any cpu, global pool)
     bool startThreading();
     void stopThreading();
 
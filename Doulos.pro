@@ -20,6 +20,9 @@ RC_FILE += Doulos.rc
 # deprecated API in order to know how to port your code away from it.
 DEFINES += QT_DEPRECATED_WARNINGS
 
+# task_scheduler_observer bound to a task_arena (thread placement of the pipeline stages)
+DEFINES += TBB_PREVIEW_LOCAL_OBSERVER=1
+
 # You can also make your code fail to compile if you use deprecated APIs.
 # In order to do so, uncomment the following line.
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
@@ -63,7 +66,12 @@ SOURCES += DataAcquisition/AlazarDAQ/AlazarDAQ.cpp \
     DataAcquisition/FLImProcess/FLImProcess.cpp \
     DataAcquisition/QpiProcess/QpiProcess.cpp \
     DataAcquisition/ImagingSource/ImagingSource.cpp \
+    DataAcquisition/FrameAssembler/FrameAssembler.cpp \
+    DataAcquisition/FrameAssembler/FrameAverager.cpp \
+    DataAcquisition/FrameAssembler/CrsTable.cpp \
+    DataAcquisition/FrameAssembler/BidirEstimator.cpp \
     DataAcquisition/ThreadManager.cpp \
+    DataAcquisition/Pipeline.cpp \
     DataAcquisition/DataAcquisition.cpp
 
 SOURCES += MemoryBuffer/MemoryBuffer.cpp
@@ -93,7 +101,12 @@ HEADERS += DataAcquisition/AlazarDAQ/AlazarDAQ.h \
     DataAcquisition/FLImProcess/FLImProcess.h \
     DataAcquisition/QpiProcess/QpiProcess.h \
     DataAcquisition/ImagingSource/ImagingSource.h \
+    DataAcquisition/FrameAssembler/FrameAssembler.h \
+    DataAcquisition/FrameAssembler/FrameAverager.h \
+    DataAcquisition/FrameAssembler/CrsTable.h \
+    DataAcquisition/FrameAssembler/BidirEstimator.h \
     DataAcquisition/ThreadManager.h \
+    DataAcquisition/Pipeline.h \
     DataAcquisition/DataAcquisition.h
 
 HEADERS += MemoryBuffer/MemoryBuffer.h
@@ -7,12 +7,12 @@
 #define NEAR_2_POWER(x)				(int)(1 << (int)ceil(log2(x)))
 
 //////////////////////// Image Setup /////////////////////////
-#define ADC_RATE					500 // MegaSamps/sec
+#define ADC_RATE					500 // MegaSamps/sec (default)
 
-#define N_SCANS		                384 // buffer width (should be 4's multiples)
-#define N_TIMES						512 // buffer height
+#define N_SCANS		                384 // buffer width (should be 4's multiples) (default)
+#define N_TIMES						512 // buffer height (default)
 
-#define N_PIXELS					2 * N_TIMES // image width (will be deprecated)
+#define N_PIXELS					2 * N_TIMES // image width (default)
 
 //////////////////////// FLIM Setup /////////////////////////
 #define FLIM_LASER_COM_PORT			"COM3"
@@ -53,14 +53,19 @@
 
 //////////////// Thread & Buffer Processing /////////////////
 #define PROCESSING_BUFFER_SIZE		100
+#define MAX_FLIM_WORKERS			8
 #define WRITING_IMAGE_SIZE          100	
 
 ///////////////////// FLIm Processing ///////////////////////
-#define FLIM_CH_START_5				50 
-#define GAUSSIAN_FILTER_WIDTH		250  // (will be deprecated)
-#define GAUSSIAN_FILTER_STD			60  // (will be deprecated)
-#define FLIM_SPLINE_FACTOR			10  // (will be deprecated)
-#define INTENSITY_THRES				0.01f
+#define FLIM_CH_START_5				50  // (default)
+#define GAUSSIAN_FILTER_WIDTH		250  // (default)
+#define GAUSSIAN_FILTER_STD			60  // (default)
+#define FLIM_SPLINE_FACTOR			10  // (default)
+#define INTENSITY_THRES				0.01f  // (default)
+
+#define FLIM_METHOD_UPSAMPLED		0  // mean delay on the up-sampled pulse (default)
+#define FLIM_METHOD_ANALYTIC		1  // mean delay from the spline coefficients (opt-in: flimMethod=1)
+#define FLIM_METHOD_PHASOR			2  // phase lifetime from the DFT harmonics
 
 //////////// Differential Phase Contrast Imaging ////////////
 #define CMOS_WIDTH					2048
@@ -99,7 +104,7 @@ enum voltage_range
 class Configuration
 {
 public:
-	explicit Configuration() : imageAveragingFrames(1), biDirScanComp(0.0f), flimLaserPower(0), crsCompensation(false), flimEmissionChannel(1) {}
+	explicit Configuration() : imageAveragingFrames(1), imageAveragingMode(0), imageAveragingAlpha(0.0f), biDirScanComp(0.0f), biDirAutoTracking(false), flimLaserPower(0), crsCompensation(false), flimEmissionChannel(1) {}
 	~Configuration() {}
 
 public:
@@ -109,19 +114,59 @@ public:
 		settings.beginGroup("configuration");
 
         // Image size
-		nScans = settings.value("nScans").toInt();		
-		nTimes = settings.value("nTimes").toInt();
-		nPixels = settings.value("nPixels").toInt();
+		nScans = settings.value("nScans", N_SCANS).toInt();		
+		nTimes = settings.value("nTimes", N_TIMES).toInt();
+		nPixels = settings.value("nPixels", N_PIXELS).toInt();
 		nLines = settings.value("nLines").toInt();
 
+		// A-line binning (1, 2, 4, 8: neighboring pulses summed before FLIm processing)
+		flimBinning = settings.value("flimBinning", 1).toInt();
+		if ((flimBinning != 1) && (flimBinning != 2) && (flimBinning != 4) && (flimBinning != 8))
+			flimBinning = 1;
+		nTimesBinned = nTimes / flimBinning;
+		nPixelsBinned = nPixels / flimBinning;
+
 		bufferSize = nScans * nTimes;
-		imageSize = nPixels * nLines;
+		imageSize = nPixelsBinned * nLines;
+
+		// Digitizer
+		adcRate = settings.value("adcRate", ADC_RATE).toInt();
+
+		// Digitizer DMA buffers (pool size, pieces of nTimes records per buffer, in-place processing of the lent buffers)
+		dmaBufferCount = settings.value("dmaBufferCount", 16).toInt();
+		dmaPiecesPerBuffer = settings.value("dmaPiecesPerBuffer", 1).toInt();
+		if ((dmaPiecesPerBuffer < 1) || (dmaPiecesPerBuffer > 2 * FAST_TOTAL_PIECES))
+			dmaPiecesPerBuffer = 1;
+		dmaLending = settings.value("dmaLending", true).toBool();
 				
-		// Image averaging
+		// Stage boundary policies (0: drop newest, 1: block)
+		for (int i = 0; i < 3; i++)
+			syncPolicy[i] = settings.value(QString("syncPolicy_%1").arg(i), 0).toInt();
+
+		// Thread placement (DAQ, FLIm processing, visualization, writer; cpus: "2-5,8", empty: any)
+		// priority: 0 (normal), 1 (high: SCHED_RR), 2 (critical: SCHED_FIFO)
+		const int default_priority[4] = { 2, 1, 0, 0 };
+		for (int i = 0; i < 4; i++)
+		{
+			placementCpus[i] = settings.value(QString("placementCpus_%1").arg(i), "").toStringList().join(",");
+			placementConcurrency[i] = settings.value(QString("placementConcurrency_%1").arg(i), 0).toInt();
+			placementNumaNode[i] = settings.value(QString("placementNumaNode_%1").arg(i), -1).toInt();
+			placementPriority[i] = settings.value(QString("placementPriority_%1").arg(i), default_priority[i]).toInt();
+		}
+
+		// Memory locking of the pipeline & writing buffers (mlockall / VirtualLock)
+		memoryLocking = settings.value("memoryLocking", true).toBool();
+
+		// Image averaging (mode: 0 block, 1 exponential moving average, 2 sliding window; alpha <= 0: 2 / (frames + 1))
 		imageAveragingFrames = settings.value("imageAveragingFrames").toInt();
+		imageAveragingMode = settings.value("imageAveragingMode", 0).toInt();
+		if ((imageAveragingMode < 0) || (imageAveragingMode > 2))
+			imageAveragingMode = 0;
+		imageAveragingAlpha = settings.value("imageAveragingAlpha", 0.0f).toFloat();
 
 		// Bidirectional scan compensation
 		biDirScanComp = settings.value("biDirScanComp").toFloat();
+		biDirAutoTracking = settings.value("biDirAutoTracking", false).toBool();
 
 		//CRS nonlinearity compensation
 		crsCompensation = settings.value("crsCompensation").toBool();
@@ -131,6 +176,7 @@ public:
 		imageStichingYStep = settings.value("imageStichingYStep").toInt();
 
         // FLIm processing
+		flimMethod = settings.value("flimMethod", FLIM_METHOD_UPSAMPLED).toInt();
 		flimBg = settings.value("flimBg").toFloat();
 		flimWidthFactor = settings.value("flimWidthFactor").toFloat();
 		for (int i = 0; i < 4; i++)
@@ -139,6 +185,15 @@ public:
 			if (i != 0)
 				flimDelayOffset[i - 1] = settings.value(QString("flimDelayOffset_%1").arg(i)).toFloat();
         }
+		flimChEndOffset = settings.value("flimChEndOffset", FLIM_CH_START_5).toInt();
+		flimSplineFactor = settings.value("flimSplineFactor", FLIM_SPLINE_FACTOR).toInt();
+		flimFilterWidth = settings.value("flimFilterWidth", GAUSSIAN_FILTER_WIDTH).toInt();
+		flimFilterStd = settings.value("flimFilterStd", GAUSSIAN_FILTER_STD).toFloat();
+		flimIntensityThres = settings.value("flimIntensityThres", INTENSITY_THRES).toFloat();
+		flimWorkers = settings.value("flimWorkers", 1).toInt();
+		if (flimWorkers < 1) flimWorkers = 1;
+		if (flimWorkers > MAX_FLIM_WORKERS) flimWorkers = MAX_FLIM_WORKERS;
+		flimSplineBenchmark = settings.value("flimSplineBenchmark", false).toBool();
 
         // Visualization
         flimEmissionChannel = settings.value("flimEmissionChannel").toInt();
@@ -204,15 +259,41 @@ public:
 
 		settings.setValue("nPixels", nPixels);
 		settings.setValue("nLines", nLines);
+		settings.setValue("flimBinning", flimBinning);
 
 		settings.setValue("bufferSize", bufferSize);
 		settings.setValue("imageSize", imageSize);
 
+		// Digitizer
+		settings.setValue("adcRate", adcRate);
+		settings.setValue("dmaBufferCount", dmaBufferCount);
+		settings.setValue("dmaPiecesPerBuffer", dmaPiecesPerBuffer);
+		settings.setValue("dmaLending", dmaLending);
+
+		// Stage boundary policies
+		for (int i = 0; i < 3; i++)
+			settings.setValue(QString("syncPolicy_%1").arg(i), syncPolicy[i]);
+
+		// Thread placement
+		for (int i = 0; i < 4; i++)
+		{
+			settings.setValue(QString("placementCpus_%1").arg(i), placementCpus[i]);
+			settings.setValue(QString("placementConcurrency_%1").arg(i), placementConcurrency[i]);
+			settings.setValue(QString("placementNumaNode_%1").arg(i), placementNumaNode[i]);
+			settings.setValue(QString("placementPriority_%1").arg(i), placementPriority[i]);
+		}
+
+		// Memory locking
+		settings.setValue("memoryLocking", memoryLocking);
+
 		// Image averaging
 		settings.setValue("imageAveragingFrames", imageAveragingFrames);
+		settings.setValue("imageAveragingMode", imageAveragingMode);
+		settings.setValue("imageAveragingAlpha", QString::number(imageAveragingAlpha, 'f', 3));
 
 		// Bidirectional scan compensation
 		settings.setValue("biDirScanComp", QString::number(biDirScanComp, 'f', 2));
+		settings.setValue("biDirAutoTracking", biDirAutoTracking);
 
 		// CRS nonlinearity compensation
 		settings.setValue("crsCompensation", crsCompensation);
@@ -222,6 +303,7 @@ public:
 		settings.setValue("imageStichingYStep", imageStichingYStep);
 
 		// FLIm processing
+		settings.setValue("flimMethod", flimMethod);
 		settings.setValue("flimBg", QString::number(flimBg, 'f', 2));
 		settings.setValue("flimWidthFactor", QString::number(flimWidthFactor, 'f', 2));
 		for (int i = 0; i < 4; i++)
@@ -230,6 +312,13 @@ public:
 			if (i != 0)
 				settings.setValue(QString("flimDelayOffset_%1").arg(i), QString::number(flimDelayOffset[i - 1], 'f', 3));
 		}
+		settings.setValue("flimChEndOffset", flimChEndOffset);
+		settings.setValue("flimSplineFactor", flimSplineFactor);
+		settings.setValue("flimFilterWidth", flimFilterWidth);
+		settings.setValue("flimFilterStd", QString::number(flimFilterStd, 'f', 1));
+		settings.setValue("flimIntensityThres", QString::number(flimIntensityThres, 'f', 3));
+		settings.setValue("flimWorkers", flimWorkers);
+		settings.setValue("flimSplineBenchmark", flimSplineBenchmark);
 
 		// Visualization
 		settings.setValue("flimEmissionChannel", flimEmissionChannel);
@@ -285,13 +374,34 @@ public:
     // Image size parameters
 	int nScans, nTimes;		
 	int nPixels, nLines;	
+	int flimBinning, nTimesBinned, nPixelsBinned;
 	int bufferSize, imageSize;
+
+	// Stage boundary policies (FLIm processing, FLIm visualization, DPC processing)
+	int syncPolicy[3];
+
+	// Digitizer
+	int adcRate;
+	int dmaBufferCount, dmaPiecesPerBuffer;
+	bool dmaLending;
+
+	// Thread placement (DAQ, FLIm processing, visualization, writer)
+	QString placementCpus[4];
+	int placementConcurrency[4];
+	int placementNumaNode[4];
+	int placementPriority[4];
+
+	// Memory locking
+	bool memoryLocking;
 	
 	// Image averaging
 	int imageAveragingFrames;
+	int imageAveragingMode;
+	float imageAveragingAlpha;
 
 	// Bidirectional scan compensation
 	float biDirScanComp;
+	bool biDirAutoTracking; // Auto: tracked until released (otherwise one estimate)
 	
 	// CRS nonlinearity compensation
 	bool crsCompensation;
@@ -301,10 +411,18 @@ public:
 	int imageStichingYStep;
 
     // FLIm processing
+	int flimMethod;
 	float flimBg;
 	float flimWidthFactor;
 	int flimChStartInd[4];
     float flimDelayOffset[3];
+	int flimChEndOffset;
+	int flimSplineFactor;
+	int flimFilterWidth;
+	float flimFilterStd;
+	float flimIntensityThres;
+	int flimWorkers; // FLImProcess instances processing whole buffers in parallel
+	bool flimSplineBenchmark; // spline engine self-test at startup (diagnostics)
 
 	// Visualization    
     int flimEmissionChannel;
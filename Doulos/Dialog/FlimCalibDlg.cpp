@@ -27,6 +27,7 @@ FlimCalibDlg::FlimCalibDlg(QWidget *parent) :
     m_pDeviceControlTab = dynamic_cast<QDeviceControlTab*>(parent);
     m_pConfig = m_pDeviceControlTab->getStreamTab()->getMainWnd()->m_pConfiguration;
     m_pFLIm = m_pDeviceControlTab->getStreamTab()->getOperationTab()->getDataAcq()->getFLIm();
+	m_pFLIm->_lifetime.keep_latest = true;
 		
 
     // Create layout
@@ -44,6 +45,7 @@ FlimCalibDlg::FlimCalibDlg(QWidget *parent) :
 
 FlimCalibDlg::~FlimCalibDlg()
 {
+	m_pFLIm->_lifetime.keep_latest = false;
     if (m_pHistogramIntensity) delete m_pHistogramIntensity;
     if (m_pHistogramLifetime) delete m_pHistogramLifetime;
 }
@@ -543,8 +545,9 @@ void FlimCalibDlg::showMeanDelay(bool checked)
     if (checked)
     {
         m_pScope_PulseView->setMeanDelayLine(5);
-		for (int i = 0; i < 5; i++)
-			m_pScope_PulseView->getRender()->m_pMdLineInd[i] = m_pFLIm->_lifetime.mean_delay(0, i) - m_pFLIm->_params.ch_start_ind[0];
+		if (m_pFLIm->_lifetime.mean_delay.length()) // copied from the next processed buffer on
+			for (int i = 0; i < 5; i++)
+				m_pScope_PulseView->getRender()->m_pMdLineInd[i] = m_pFLIm->_lifetime.mean_delay(0, i) - m_pFLIm->_params.ch_start_ind[0];
     }
     else
     {
@@ -555,6 +558,9 @@ void FlimCalibDlg::showMeanDelay(bool checked)
 
 void FlimCalibDlg::splineView(bool checked)
 {
+	m_pFLIm->_resize.materialize = checked;
+	m_pFLIm->publishParameters();
+
     //if (m_pCheckBox_ShowWindow->isChecked())
     //{
     //    int* ch_ind = (!checked) ? m_pFLIm->_params.ch_start_ind : m_pFLIm->_resize.ch_start_ind1;
@@ -601,6 +607,7 @@ void FlimCalibDlg::captureBackground(const QString &str)
 	m_pScope_PulseView->setDcLine(bg - (POWER_2(15) - POWER_2(12)));
     m_pFLIm->_params.bg = bg;
     m_pConfig->flimBg = bg;
+    m_pFLIm->publishParameters();
 }
 
 void FlimCalibDlg::resetChStart0(double start)
@@ -609,6 +616,7 @@ void FlimCalibDlg::resetChStart0(double start)
 	
     m_pFLIm->_params.ch_start_ind[0] = ch_ind;
     m_pConfig->flimChStartInd[0] = ch_ind;
+    m_pFLIm->publishParameters();
 	
     ///printf("[Ch 0] %d %d %d %d\n",
     ///    m_pFLIm->_params.ch_start_ind[0], m_pFLIm->_params.ch_start_ind[1],
@@ -632,8 +640,8 @@ void FlimCalibDlg::resetChStart0(double start)
 				m_pScope_PulseView->getRender()->m_pWinLineInd[0] = m_pFLIm->_params.ch_start_ind[i] - ch_ind;
 				m_pImageView_PulseImage->getRender()->m_pVLineInd[0] = m_pFLIm->_params.ch_start_ind[i] - ch_ind;
 			}
-			m_pScope_PulseView->getRender()->m_pWinLineInd[4] = m_pFLIm->_params.ch_start_ind[3] - ch_ind + FLIM_CH_START_5;
-			m_pImageView_PulseImage->getRender()->m_pVLineInd[4] = m_pFLIm->_params.ch_start_ind[3] - ch_ind + FLIM_CH_START_5;
+			m_pScope_PulseView->getRender()->m_pWinLineInd[4] = m_pFLIm->_params.ch_start_ind[3] - ch_ind + m_pFLIm->_params.ch_end_offset;
+			m_pImageView_PulseImage->getRender()->m_pVLineInd[4] = m_pFLIm->_params.ch_start_ind[3] - ch_ind + m_pFLIm->_params.ch_end_offset;
 		}
     }
 
@@ -646,6 +654,7 @@ void FlimCalibDlg::resetChStart1(double start)
 	
     m_pFLIm->_params.ch_start_ind[1] = ch_ind;
     m_pConfig->flimChStartInd[1] = ch_ind;
+    m_pFLIm->publishParameters();
 
     m_pFLIm->_resize.initiated = false;
 
@@ -680,6 +689,7 @@ void FlimCalibDlg::resetChStart2(double start)
 
     m_pFLIm->_params.ch_start_ind[2] = ch_ind;
     m_pConfig->flimChStartInd[2] = ch_ind;
+    m_pFLIm->publishParameters();
 
     m_pFLIm->_resize.initiated = false;
 
@@ -745,8 +755,9 @@ void FlimCalibDlg::resetChStart3(double start)
 	int ch_ind = (int)round(start / m_pFLIm->_params.samp_intv);
 
 	m_pFLIm->_params.ch_start_ind[3] = ch_ind;
-	m_pFLIm->_params.ch_start_ind[4] = ch_ind + FLIM_CH_START_5;
+	m_pFLIm->_params.ch_start_ind[4] = ch_ind + m_pFLIm->_params.ch_end_offset;
 	m_pConfig->flimChStartInd[3] = ch_ind;
+	m_pFLIm->publishParameters();
 
 	///printf("[Ch 4] %d %d %d %d\n",
 	///    m_pFLIm->_params.ch_start_ind[0], m_pFLIm->_params.ch_start_ind[1],
@@ -760,15 +771,15 @@ void FlimCalibDlg::resetChStart3(double start)
 		{
 			m_pScope_PulseView->getRender()->m_pWinLineInd[3] = ch_ind; /// (int)round((float)(ch_ind)* factor);
 			m_pImageView_PulseImage->getRender()->m_pVLineInd[3] = ch_ind;
-			m_pScope_PulseView->getRender()->m_pWinLineInd[4] = ch_ind + FLIM_CH_START_5;
-			m_pImageView_PulseImage->getRender()->m_pVLineInd[4] = ch_ind + FLIM_CH_START_5;
+			m_pScope_PulseView->getRender()->m_pWinLineInd[4] = ch_ind + m_pFLIm->_params.ch_end_offset;
+			m_pImageView_PulseImage->getRender()->m_pVLineInd[4] = ch_ind + m_pFLIm->_params.ch_end_offset;
 		}
 		else
 		{
 			m_pScope_PulseView->getRender()->m_pWinLineInd[3] = ch_ind - m_pFLIm->_params.ch_start_ind[0];
 			m_pImageView_PulseImage->getRender()->m_pVLineInd[3] = ch_ind - m_pFLIm->_params.ch_start_ind[0];
-			m_pScope_PulseView->getRender()->m_pWinLineInd[4] = ch_ind - m_pFLIm->_params.ch_start_ind[0] + FLIM_CH_START_5;
-			m_pImageView_PulseImage->getRender()->m_pVLineInd[4] = ch_ind - m_pFLIm->_params.ch_start_ind[0] + FLIM_CH_START_5;
+			m_pScope_PulseView->getRender()->m_pWinLineInd[4] = ch_ind - m_pFLIm->_params.ch_start_ind[0] + m_pFLIm->_params.ch_end_offset;
+			m_pImageView_PulseImage->getRender()->m_pVLineInd[4] = ch_ind - m_pFLIm->_params.ch_start_ind[0] + m_pFLIm->_params.ch_end_offset;
 		}
 	}
 
@@ -785,4 +796,5 @@ void FlimCalibDlg::resetDelayTimeOffset()
         m_pFLIm->_params.delay_offset[i] = delay_offset[i];
         m_pConfig->flimDelayOffset[i] = delay_offset[i];
     }
+    m_pFLIm->publishParameters();
 }
@@ -28,16 +28,10 @@ MainWindow::MainWindow(QWidget *parent) :
     m_pConfiguration = new Configuration;
     m_pConfiguration->getConfigFile("Doulos.ini");
 
-	m_pConfiguration->nScans = N_SCANS;
-	m_pConfiguration->nTimes = N_TIMES;
-
-	m_pConfiguration->nPixels = N_PIXELS;
-	m_pConfiguration->nTimes = N_TIMES;
-
 	m_pConfiguration->flimLaserRepRate = FLIM_LASER_REP_RATE;
 
 	m_pConfiguration->bufferSize = m_pConfiguration->nScans * m_pConfiguration->nTimes;
-	m_pConfiguration->imageSize = m_pConfiguration->nPixels * m_pConfiguration->nLines;
+	m_pConfiguration->imageSize = m_pConfiguration->nPixelsBinned * m_pConfiguration->nLines;
 
     // Set timer for renew configuration
     m_pTimer = new QTimer(this);
@@ -62,6 +56,10 @@ MainWindow::MainWindow(QWidget *parent) :
 	m_pStatusLabel_SyncStatus = new QLabel(QString("FP bufn: %1 / FV bufn: %2 ")
 		.arg(fp_bfn, 3).arg(fv_bfn, 3), this);
 
+	m_pStatusLabel_Dropped = new QLabel("Drop FP: 0 / FV: 0 / DPC: 0", this);
+	m_pStatusLabel_Dropped->setStyleSheet("color: green;");
+	m_pStatusLabel_Dropped->setAlignment(Qt::AlignCenter);
+
 	m_pStatusLabel_Acquisition = new QLabel("Acquistion X", this);
 	m_pStatusLabel_Acquisition->setStyleSheet("color: red;");
 	m_pStatusLabel_Acquisition->setAlignment(Qt::AlignCenter);
@@ -75,6 +73,7 @@ MainWindow::MainWindow(QWidget *parent) :
     pStatusLabel_Temp1->setFrameStyle(QFrame::Panel | QFrame::Sunken);
     m_pStatusLabel_ImagePos->setFrameStyle(QFrame::Panel | QFrame::Sunken);
 	m_pStatusLabel_SyncStatus->setFrameStyle(QFrame::Panel | QFrame::Sunken);
+	m_pStatusLabel_Dropped->setFrameStyle(QFrame::Panel | QFrame::Sunken);
 
 	m_pStatusLabel_Acquisition->setFrameStyle(QFrame::Panel | QFrame::Sunken);
 	m_pStatusLabel_Recording->setFrameStyle(QFrame::Panel | QFrame::Sunken);
@@ -84,6 +83,7 @@ MainWindow::MainWindow(QWidget *parent) :
     statusBar()->addPermanentWidget(pStatusLabel_Temp1, 10);
     statusBar()->addPermanentWidget(m_pStatusLabel_ImagePos, 1);
     statusBar()->addPermanentWidget(m_pStatusLabel_SyncStatus, 2);
+	statusBar()->addPermanentWidget(m_pStatusLabel_Dropped, 2);
 	statusBar()->addPermanentWidget(m_pStatusLabel_Acquisition, 1);
 	statusBar()->addPermanentWidget(m_pStatusLabel_Recording, 1);
 	statusBar()->addPermanentWidget(m_pStatusLabel_StageMoving, 1);
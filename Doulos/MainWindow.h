@@ -55,6 +55,7 @@ public:
     // Status bar
     QLabel *m_pStatusLabel_ImagePos;
 	QLabel *m_pStatusLabel_SyncStatus;
+	QLabel *m_pStatusLabel_Dropped;
 
 	QLabel *m_pStatusLabel_Acquisition;
 	QLabel *m_pStatusLabel_Recording;
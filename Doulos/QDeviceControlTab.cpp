@@ -223,7 +223,7 @@ void QDeviceControlTab::createScanControl()
     m_pCheckBox_GalvoScanControl = new QCheckBox(m_pGroupBox_ScannerControl);
     m_pCheckBox_GalvoScanControl->setText("Start Galvano Mirror Scanning");
 	
-	m_pLabel_GalvoFastScanFreq = new QLabel(QString("Scan Freq  %1 Hz").arg(FAST_SCAN_FREQ), m_pGroupBox_ScannerControl);
+	m_pLabel_GalvoFastScanFreq = new QLabel(QString("Scan Freq  %1 Hz").arg(FLIM_LASER_REP_RATE / (double)(2 * m_pConfig->nPixels)), m_pGroupBox_ScannerControl);
 	
 	for (int i = 0; i < 2; i++)
 	{
@@ -623,7 +623,7 @@ void QDeviceControlTab::startFlimTriggering(bool toggled)
 		m_pFlimTrigControlLaser->triggerSource = NI_FLIM_TRIG_SOURCE;
 		m_pFlimTrigControlLaser->counterChannel = NI_FLIM_TRIG_CHANNEL;
 		m_pFlimTrigControlLaser->frequency = FLIM_LASER_REP_RATE;
-		m_pFlimTrigControlLaser->finite_samps = FLIM_LASER_FINITE_SAMPS;
+		m_pFlimTrigControlLaser->finite_samps = 2 * m_pConfig->nPixels;
 
 		if (!m_pFlimTrigControlDAQ)
 		{
@@ -636,7 +636,7 @@ void QDeviceControlTab::startFlimTriggering(bool toggled)
 		m_pFlimTrigControlDAQ->triggerSource = ALAZAR_DAQ_TRIG_SOURCE;
 		m_pFlimTrigControlDAQ->counterChannel = ALAZAR_DAQ_TRIG_CHANNEL;
 		m_pFlimTrigControlDAQ->frequency = FLIM_LASER_REP_RATE;
-		m_pFlimTrigControlDAQ->finite_samps = FLIM_LASER_FINITE_SAMPS;
+		m_pFlimTrigControlDAQ->finite_samps = 2 * m_pConfig->nPixels;
 
 		// Create master triggering control objects
 		if (!m_pMasterTrigger)
@@ -649,7 +649,7 @@ void QDeviceControlTab::startFlimTriggering(bool toggled)
 		}		
 		m_pMasterTrigger->counterChannel = NI_MASTER_TRIG_CHANNEL;
 		m_pMasterTrigger->frequency = FLIM_LASER_REP_RATE;
-		m_pMasterTrigger->finite_samps = FLIM_LASER_FINITE_SAMPS;
+		m_pMasterTrigger->finite_samps = 2 * m_pConfig->nPixels;
 				
         // Initializing
 		if (!m_pFlimTrigControlLaser->initialize() || !m_pFlimTrigControlDAQ->initialize() || !m_pMasterTrigger->initialize())
@@ -871,13 +871,13 @@ void QDeviceControlTab::connectGalvanoMirror(bool toggled)
 		}
 		m_pGalvoScan->physicalChannel = NI_GALVO_CHANNEL;
 		m_pGalvoScan->sourceTerminal = NI_GALVO_SOURCE;		
-		m_pGalvoScan->freq_fast = FAST_SCAN_FREQ;
+		m_pGalvoScan->freq_fast = FLIM_LASER_REP_RATE / (double)(2 * m_pConfig->nPixels);
 		m_pGalvoScan->max_rate = FLIM_LASER_REP_RATE / m_pGalvoSlaveTrigger->slow;
 		m_pGalvoScan->pp_voltage_fast = m_pLineEdit_PeakToPeakVoltage[0]->text().toDouble();
 		m_pGalvoScan->pp_voltage_slow = m_pLineEdit_PeakToPeakVoltage[1]->text().toDouble();
 		m_pGalvoScan->offset_fast = m_pLineEdit_OffsetVoltage[0]->text().toDouble();			
 		m_pGalvoScan->offset_slow = m_pLineEdit_OffsetVoltage[1]->text().toDouble();
-		m_pGalvoScan->step = (N_PIXELS / m_pGalvoSlaveTrigger->slow) * (m_pConfig->nLines + GALVO_FLYING_BACK + 2);
+		m_pGalvoScan->step = (m_pConfig->nPixels / m_pGalvoSlaveTrigger->slow) * (m_pConfig->nLines + GALVO_FLYING_BACK + 2);
 		 
         // Initializing
 		if ((!m_pGalvoScan->initialize()) || (!m_pGalvoSlaveTrigger->initialize()))
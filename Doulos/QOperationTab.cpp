@@ -8,8 +8,11 @@
 
 #include <DataAcquisition/DataAcquisition.h>
 #include <DataAcquisition/ThreadManager.h>
+#include <DataAcquisition/Pipeline.h>
 #include <MemoryBuffer/MemoryBuffer.h>
 
+#include <Common/Tracer.h>
+
 #include <iostream>
 #include <thread>
 #include <chrono>
@@ -52,6 +55,12 @@ QOperationTab::QOperationTab(QWidget *parent) :
     m_pToggleButton_Saving->setText("&Save Recorded Data");
 	m_pToggleButton_Saving->setDisabled(true);
 
+    m_pToggleButton_Tracing = new QPushButton(this);
+    m_pToggleButton_Tracing->setCheckable(true);
+    m_pToggleButton_Tracing->setFixedSize(50, 30);
+    m_pToggleButton_Tracing->setText("&Trace");
+	m_pToggleButton_Tracing->setToolTip("Record hot-path spans and dump a Chrome / Perfetto trace (trace_*.json) when untoggled");
+
     // Create a progress bar (general purpose?)
     m_pProgressBar = new QProgressBar(this);
     m_pProgressBar->setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Fixed);
@@ -68,6 +77,7 @@ QOperationTab::QOperationTab(QWidget *parent) :
     pHBoxLayout->addWidget(m_pToggleButton_Acquisition);
     pHBoxLayout->addWidget(m_pToggleButton_Recording);
     pHBoxLayout->addWidget(m_pToggleButton_Saving);
+    pHBoxLayout->addWidget(m_pToggleButton_Tracing);
 
     m_pVBoxLayout->addItem(pHBoxLayout);
     m_pVBoxLayout->addWidget(m_pProgressBar);
@@ -80,6 +90,7 @@ QOperationTab::QOperationTab(QWidget *parent) :
     connect(m_pToggleButton_Acquisition, SIGNAL(toggled(bool)), this, SLOT(operateDataAcquisition(bool)));
 	connect(m_pToggleButton_Recording, SIGNAL(toggled(bool)), this, SLOT(operateDataRecording(bool)));
     connect(m_pToggleButton_Saving, SIGNAL(toggled(bool)), this, SLOT(operateDataSaving(bool)));
+	connect(m_pToggleButton_Tracing, SIGNAL(toggled(bool)), this, SLOT(operateTracing(bool)));
     connect(m_pMemoryBuffer, SIGNAL(finishedBufferAllocation()), this, SLOT(setAcqRecEnable()));
 	connect(m_pMemoryBuffer, SIGNAL(finishedWritingThread(bool)), this, SLOT(setSaveButtonDefault(bool)));
 	connect(m_pMemoryBuffer, SIGNAL(wroteSingleFrame(int)), m_pProgressBar, SLOT(setValue(int)));
@@ -104,9 +115,8 @@ void QOperationTab::operateDataAcquisition(bool toggled)
         if (m_pDataAcquisition->InitializeAcquistion(m_pStreamTab->getCurrentModality()))
         {
             // Start Thread Process
-            m_pStreamTab->m_pThreadVisualization->startThreading();
-			if (m_pStreamTab->getCurrentModality())
-				m_pStreamTab->m_pThreadFlimProcess->startThreading();			
+            m_pStreamTab->resetSyncStats();
+            m_pStreamTab->getPipeline(m_pStreamTab->getCurrentModality())->start();
 
             // Start Data Acquisition
             if (m_pDataAcquisition->StartAcquisition(m_pStreamTab->getCurrentModality()))
@@ -170,9 +180,7 @@ void QOperationTab::operateDataAcquisition(bool toggled)
     {
         // Stop Thread Process
         m_pDataAcquisition->StopAcquisition(m_pStreamTab->getCurrentModality());
-		if (m_pStreamTab->getCurrentModality())
-			m_pStreamTab->m_pThreadFlimProcess->stopThreading();
-        m_pStreamTab->m_pThreadVisualization->stopThreading();
+        m_pStreamTab->getPipeline(m_pStreamTab->getCurrentModality())->stop();
 
 		///std::thread deallocate_writing_buffer([&]() {
 		///	m_pMemoryBuffer->deallocateWritingBuffer();
@@ -277,6 +285,27 @@ void QOperationTab::operateDataSaving(bool toggled)
     }
 }
 
+void QOperationTab::operateTracing(bool toggled)
+{
+	if (toggled)
+	{
+		Tracer::start();
+		m_pToggleButton_Tracing->setText("Tracing");
+	}
+	else
+	{
+		Tracer::stop();
+		m_pToggleButton_Tracing->setText("&Trace");
+
+		// Dump the spans recorded since the toggle
+		QString fileName = QString("trace_%1.json").arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"));
+		if (Tracer::dump(fileName.toLocal8Bit().constData()))
+			emit m_pStreamTab->sendStatusMessage(QString("Trace is written: %1").arg(QFileInfo(fileName).absoluteFilePath()), false);
+		else
+			emit m_pStreamTab->sendStatusMessage(QString("Failed to write the trace: %1").arg(fileName), true);
+	}
+}
+
 
 void QOperationTab::setAcqRecEnable()
 {
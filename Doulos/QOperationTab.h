@@ -38,6 +38,7 @@ private slots:
 	void operateDataAcquisition(bool toggled);
 	void operateDataRecording(bool toggled);
     void operateDataSaving(bool toggled);
+	void operateTracing(bool toggled);
 
 public slots :
 	void setAcqRecEnable();
@@ -63,6 +64,7 @@ private:
 	QPushButton *m_pToggleButton_Acquisition;
 	QPushButton *m_pToggleButton_Recording;
     QPushButton *m_pToggleButton_Saving;
+	QPushButton *m_pToggleButton_Tracing;
 	QProgressBar *m_pProgressBar;
 };
 
@@ -10,9 +10,17 @@
 
 #include <DataAcquisition/DataAcquisition.h>
 #include <DataAcquisition/ThreadManager.h>
+#include <DataAcquisition/Pipeline.h>
 
 #include <DataAcquisition/FLImProcess/FLImProcess.h>
 #include <DataAcquisition/ImagingSource/ImagingSource.h>
+#include <DataAcquisition/FrameAssembler/FrameAssembler.h>
+#include <DataAcquisition/FrameAssembler/FrameAverager.h>
+#include <DataAcquisition/FrameAssembler/CrsTable.h>
+#include <DataAcquisition/FrameAssembler/BidirEstimator.h>
+
+#include <Common/ThreadPlacement.h>
+#include <Common/RealTime.h>
 
 #include <DeviceControl/NanoscopeStage/NanoscopeStage.h>
 
@@ -110,12 +118,19 @@ QStreamTab::QStreamTab(QWidget *parent) :
 	m_pLineEdit_Averaging->setAlignment(Qt::AlignCenter);
 	m_pLineEdit_Averaging->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
 
+	m_pComboBox_AveragingMode = new QComboBox(this);
+	m_pComboBox_AveragingMode->addItem("Block");
+	m_pComboBox_AveragingMode->addItem("Exponential");
+	m_pComboBox_AveragingMode->addItem("Sliding");
+	m_pComboBox_AveragingMode->setCurrentIndex(m_pConfig->imageAveragingMode);
+	m_pComboBox_AveragingMode->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+
 	m_pLabel_AcquisitionStatus = new QLabel(this);
 	QString str; str.sprintf("Written: %7d / %7d   Avg: %3d / %3d   Rec: %3d / %3d", 0, m_pConfig->imageSize, 0, m_pConfig->imageAveragingFrames, 0, m_pConfig->imageStichingXStep * m_pConfig->imageStichingYStep);
 	m_pLabel_AcquisitionStatus->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
 	m_pLabel_AcquisitionStatus->setText(str);
 
-#if (CRS_DIR_FACTOR == 2)
+#if (FAST_DIR_FACTOR == 2)
 	// Create bidirectional scan compensation-related widgets
 	m_pLabel_BiDirScanComp = new QLabel(this);
 	m_pLabel_BiDirScanComp->setText("Bidirectional Scan Compensation  ");
@@ -125,13 +140,15 @@ QStreamTab::QStreamTab(QWidget *parent) :
 	m_pDoubleSpinBox_BiDirScanComp->setRange(-100.0, 100.0);
 	m_pDoubleSpinBox_BiDirScanComp->setSingleStep(0.1);
 	m_pDoubleSpinBox_BiDirScanComp->setValue(m_pConfig->biDirScanComp);
-	m_pDoubleSpinBox_BiDirScanComp->setDecimals(1);
+	m_pDoubleSpinBox_BiDirScanComp->setDecimals(2);
 	m_pDoubleSpinBox_BiDirScanComp->setAlignment(Qt::AlignCenter);
 	m_pDoubleSpinBox_BiDirScanComp->setDisabled(false);
 
 	m_pPushButton_AutoCorr = new QPushButton(this);
 	m_pPushButton_AutoCorr->setText("Auto");	
 	m_pPushButton_AutoCorr->setFixedWidth(40);
+	m_pPushButton_AutoCorr->setCheckable(true);
+	m_pPushButton_AutoCorr->setToolTip("Estimate the bidirectional scan compensation from the live frames\n(tracked until released when biDirAutoTracking is set)");
 #endif
 		
 	// CRS nonlinearity compensation
@@ -139,12 +156,7 @@ QStreamTab::QStreamTab(QWidget *parent) :
 	m_pCheckBox_CRSNonlinearityComp->setText("CRS Nonlinearity Compensation");
 	///m_pCheckBox_CRSNonlinearityComp->setDisabled(true);
 
-	m_pCRSCompIdx = np::FloatArray2(m_pConfig->nPixels, 2);
-	for (int i = 0; i < m_pConfig->nPixels; i++)
-	{
-		m_pCRSCompIdx(i, 0) = i;
-		m_pCRSCompIdx(i, 1) = 1;
-	}
+	m_pCrsTable = new CrsTable;
 
 	m_pCheckBox_CRSNonlinearityComp->setChecked(m_pConfig->crsCompensation);
 	if (m_pConfig->crsCompensation) changeCRSNonlinearityComp(true);
@@ -222,8 +234,9 @@ QStreamTab::QStreamTab(QWidget *parent) :
 	pHBoxLayout_Averaging->addItem(new QSpacerItem(0, 0, QSizePolicy::MinimumExpanding, QSizePolicy::Fixed));
 	pHBoxLayout_Averaging->addWidget(m_pLabel_Averaging);
 	pHBoxLayout_Averaging->addWidget(m_pLineEdit_Averaging);
+	pHBoxLayout_Averaging->addWidget(m_pComboBox_AveragingMode);
 
-#if (CRS_DIR_FACTOR == 2)
+#if (FAST_DIR_FACTOR == 2)
 	QHBoxLayout *pHBoxLayout_Bidir = new QHBoxLayout;
 	pHBoxLayout_Bidir->setSpacing(2);
 
@@ -244,7 +257,7 @@ QStreamTab::QStreamTab(QWidget *parent) :
 	pVBoxLayout_ImageSize->addItem(pHBoxLayout_YLines);
 	pVBoxLayout_ImageSize->addItem(pHBoxLayout_Averaging);
 	pVBoxLayout_ImageSize->addItem(pHBoxLayout_CRS);	
-#if (CRS_DIR_FACTOR == 2)
+#if (FAST_DIR_FACTOR == 2)
 	pVBoxLayout_ImageSize->addItem(pHBoxLayout_Bidir);
 #endif	
 	pVBoxLayout_ImageSize->addWidget(m_pLabel_AcquisitionStatus);
@@ -317,14 +330,38 @@ QStreamTab::QStreamTab(QWidget *parent) :
 	m_pGroupBox_StitchingTab->setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Fixed);
 	m_pGroupBox_StitchingTab->setFixedWidth(332);
 
-	// Create thread managers for data processing
-	m_pThreadFlimProcess = new ThreadManager("FLIm image process");
-	m_pThreadVisualization = new ThreadManager("Visualization process");
-
-	// Create buffers for threading operation		
-	m_syncFlimProcessing.allocate_queue_buffer(m_pConfig->nScans, m_pConfig->nTimes, PROCESSING_BUFFER_SIZE); // FLIm Processing
-	m_syncFlimVisualization.allocate_queue_buffer(11, m_pConfig->nTimes, PROCESSING_BUFFER_SIZE); // FLIm Visualization
-	m_syncDpcProcessing.allocate_queue_buffer(CMOS_WIDTH, CMOS_HEIGHT, PROCESSING_BUFFER_SIZE); // DPC Processing 
+	// Create stage graphs (pipelines) and their buffer pools
+	int n_workers = m_pOperationTab->getDataAcq()->getFLImWorkers();
+	m_pPipelineFlim = new Pipeline("FLIm");
+	m_pEdgeFlimPulse = m_pPipelineFlim->addEdge<uint16_t>("FLIm processing", m_pConfig->nScans, m_pConfig->nTimes, PROCESSING_BUFFER_SIZE, n_workers, m_pConfig->syncPolicy[SYNC_FLIM_PROCESSING]);
+	m_pEdgeFlimResult = m_pPipelineFlim->addEdge<float>("FLIm visualization", FLIM_RESULT_ROWS, m_pConfig->nTimes, PROCESSING_BUFFER_SIZE, n_workers, m_pConfig->syncPolicy[SYNC_FLIM_VISUALIZATION]);
+	m_pPipelineDpc = new Pipeline("DPC");
+	m_pEdgeDpcImage = m_pPipelineDpc->addEdge<uint16_t>("DPC processing", CMOS_WIDTH, CMOS_HEIGHT, PROCESSING_BUFFER_SIZE, 1, m_pConfig->syncPolicy[SYNC_DPC_PROCESSING]);
+	for (Pipeline* pPipeline : { m_pPipelineFlim, m_pPipelineDpc })
+	{
+		pPipeline->SendStatusMessage += [&](const char* msg, bool is_error) {
+			if (is_error) m_pOperationTab->setAcquisitionButton(false);
+			QString qmsg = QString::fromUtf8(msg);
+			emit sendStatusMessage(qmsg, is_error);
+		};
+	}
+	resetSyncStats();
+	emit sendStatusMessage(QString::fromStdString(RealTime::report()), false);
+	m_pCalibPulse = np::FloatArray2(m_pConfig->nScans, m_pConfig->nTimes); // FLIm calibration view
+	m_pFrameAssembler = new FrameAssembler;
+	m_pFrameAverager = new FrameAverager;
+	m_pBidirEstimator = new BidirEstimator;
+	m_pBidirEstimator->DidEstimate += [&](float shift, float correlation) {
+		QString qmsg; qmsg.sprintf("Bidirectional scan compensation: %.2f (correlation: %.2f)", shift, correlation);
+		emit sendStatusMessage(qmsg, false);
+		if (!m_pConfig->biDirAutoTracking)
+			emit finishAutoCrsComp(false);
+	};
+	m_nBidirRevision = 0;
+	m_nDirtyRow = 0;
+	m_nLastRefresh_ns = 0;
+	m_pRecordingImage = nullptr;
+	m_nRecordedRows = 0;
 
 	// Set signal object
 	setFlimAcquisitionCallback();
@@ -358,14 +395,18 @@ QStreamTab::QStreamTab(QWidget *parent) :
 	// Set timer for monitoring status
 	m_pTimer_Monitoring = new QTimer(this);
 	m_pTimer_Monitoring->start(100); // renew per 100 msec
+	m_nMonitoringTicks = 0;
 
 	// Connect signal and slot
 	connect(m_pButtonGroup_Modality, SIGNAL(buttonClicked(int)), this, SLOT(changeModality(int)));
 	connect(m_pButtonGroup_YLines, SIGNAL(buttonClicked(int)), this, SLOT(changeYLines(int)));
 	connect(m_pLineEdit_Averaging, SIGNAL(textChanged(const QString &)), this, SLOT(changeAveragingFrame(const QString &)));
-#if (2 == CRS_DIR_FACTOR)	
+	connect(m_pComboBox_AveragingMode, SIGNAL(currentIndexChanged(int)), this, SLOT(changeAveragingMode(int)));
+#if (FAST_DIR_FACTOR == 2)
 		connect(m_pDoubleSpinBox_BiDirScanComp, SIGNAL(valueChanged(double)), this, SLOT(changeBiDirScanComp(double)));
-		connect(m_pPushButton_AutoCorr, SIGNAL(clicked(bool)), this, SLOT(autoCrsCompSet()));
+		connect(m_pPushButton_AutoCorr, SIGNAL(toggled(bool)), this, SLOT(autoCrsCompSet(bool)));
+		connect(this, SIGNAL(setBiDirScanComp(double)), m_pDoubleSpinBox_BiDirScanComp, SLOT(setValue(double)));
+		connect(this, SIGNAL(finishAutoCrsComp(bool)), m_pPushButton_AutoCorr, SLOT(setChecked(bool)));
 #endif
 	connect(m_pCheckBox_CRSNonlinearityComp, SIGNAL(toggled(bool)), this, SLOT(changeCRSNonlinearityComp(bool)));
 	connect(m_pSlider_Gain, SIGNAL(valueChanged(int)), this, SLOT(changeCmosGain(int)));
@@ -380,8 +421,12 @@ QStreamTab::QStreamTab(QWidget *parent) :
 QStreamTab::~QStreamTab()
 {
 	m_pTimer_Monitoring->stop();
-    if (m_pThreadVisualization) delete m_pThreadVisualization;	
-    if (m_pThreadFlimProcess) delete m_pThreadFlimProcess;
+    if (m_pPipelineFlim) delete m_pPipelineFlim;
+    if (m_pPipelineDpc) delete m_pPipelineDpc;
+	if (m_pFrameAssembler) delete m_pFrameAssembler;
+	if (m_pBidirEstimator) delete m_pBidirEstimator;
+	if (m_pFrameAverager) delete m_pFrameAverager;
+	if (m_pCrsTable) delete m_pCrsTable;
 }
 
 void QStreamTab::keyPressEvent(QKeyEvent *e)
@@ -400,6 +445,7 @@ void QStreamTab::setYLinesWidgets(bool enabled)
 	m_nAcquiredFrames = 0;
 	m_nImageCount = 0;
 	m_nAverageCount = 1;
+	m_pFrameAverager->restart();
 
 	m_pLabel_Modality->setEnabled(enabled);
 	m_pRadioButton_FLIM->setEnabled(enabled);
@@ -416,6 +462,7 @@ void QStreamTab::setAveragingWidgets(bool enabled)
 {
 	m_pLabel_Averaging->setEnabled(enabled);
 	m_pLineEdit_Averaging->setEnabled(enabled);
+	m_pComboBox_AveragingMode->setEnabled(enabled);
 	m_pCheckBox_CRSNonlinearityComp->setEnabled(enabled);
 
 	if (getDeviceControlTab()->getNanoscopeStageControl()->isChecked())
@@ -460,32 +507,41 @@ void QStreamTab::setFlimAcquisitionCallback()
 	MemoryBuffer *pMemBuff = m_pOperationTab->m_pMemoryBuffer;
 
 	DataAcquisition* pDataAcq = m_pOperationTab->getDataAcq();
-	pDataAcq->ConnectDaqAcquiredFlimData([&, pMemBuff](int frame_count, const void* _frame_ptr) {
+	m_pEdgeFlimPulse->returnLease = [pDataAcq](int lease) { pDataAcq->ReleaseDaqBuffer(lease); };
+
+	pDataAcq->ConnectDaqAcquiredFlimData([&, pMemBuff, pDataAcq](int frame_count, const void* _frame_ptr) {
 
 		static bool recording_phase = false;
 		
 		// Data transfer for FLIm processing
 		const uint16_t* frame_ptr = (uint16_t*)_frame_ptr;
 
-		// Get buffer from threading queue
-		float* pulse_ptr = nullptr;
-		{
-			std::unique_lock<std::mutex> lock(m_syncFlimProcessing.mtx);
-
-			if (!m_syncFlimProcessing.queue_buffer.empty())
-			{
-				pulse_ptr = m_syncFlimProcessing.queue_buffer.front();
-				m_syncFlimProcessing.queue_buffer.pop();
-			}
-		}
+		// Frame descriptor (position of the buffer within the frame)
+		int pieces = FAST_TOTAL_PIECES / FAST_DIR_FACTOR;
+		int frame_count0 = frame_count % (pieces * (m_pConfig->nLines + GALVO_FLYING_BACK + 2));
+
+		FrameDescriptor desc;
+		desc.seq = (uint64_t)frame_count;
+		desc.timestamp_ns = FrameDescriptor::now();
+		desc.line_offset = frame_count0 / pieces;
+		desc.piece = frame_count0 % pieces;
+		desc.scan_dir = (desc.line_offset % FAST_DIR_FACTOR) ? SCAN_DIR_BACKWARD : SCAN_DIR_FORWARD;
+		desc.modality = FRAME_MODALITY_FLIM;
+
+		// Processed in place: the DMA buffer is lent to the FLIm workers (no copy)
+		// Otherwise: copy to a buffer of the threading queue (lanes of the FLIm workers in round-robin order)
+		int lane = -1;
+		uint16_t* pulse_ptr = nullptr;
+		if (m_pConfig->dmaLending)
+			desc.lease = pDataAcq->LendDaqBuffer();
+		if (desc.lease >= 0)
+			pulse_ptr = const_cast<uint16_t*>(frame_ptr);
+		else if ((pulse_ptr = m_pEdgeFlimPulse->acquire(&lane)) != nullptr)
+			memcpy(pulse_ptr, frame_ptr, sizeof(uint16_t) * m_pConfig->bufferSize); // raw records; conversion happens in the FLIm ingest stage
 
 		if (pulse_ptr != nullptr)
 		{
-			// Body			
-			ippsConvert_16u32f(frame_ptr, pulse_ptr, m_pConfig->bufferSize);
-
 			// Show pulse
-			int frame_count0 = frame_count % (FAST_TOTAL_PIECES / FAST_DIR_FACTOR * (m_pConfig->nLines + GALVO_FLYING_BACK + 2));
 			{
 				if (m_pDeviceControlTab->getFlimCalibDlg())
 				{
@@ -494,10 +550,13 @@ void QStreamTab::setFlimAcquisitionCallback()
 
 					///printf("(%d %d) (%d %d) (%d %d)\n", frame_count, frame_count0, x, y, valid_buf, x0);
 
-					int x0 = !(y % FAST_DIR_FACTOR) ? x : m_pConfig->nPixels - 1 - x;
-					if (frame_count0 % (FAST_TOTAL_PIECES / FAST_DIR_FACTOR) == x0 / N_TIMES)
-						if (frame_count0 / (FAST_TOTAL_PIECES / FAST_DIR_FACTOR) == (y + GALVO_FLYING_BACK + 2))
-							emit m_pDeviceControlTab->getFlimCalibDlg()->plotRoiPulse(pulse_ptr, x0 % N_TIMES);
+					int x0 = (!(y % FAST_DIR_FACTOR) ? x : m_pConfig->nPixelsBinned - 1 - x) * m_pConfig->flimBinning;
+					if (desc.piece == x0 / m_pConfig->nTimes)
+						if (desc.line_offset == (y + GALVO_FLYING_BACK + 2))
+						{
+							ippsConvert_16u32f(frame_ptr, m_pCalibPulse.raw_ptr(), m_pConfig->bufferSize);
+							emit m_pDeviceControlTab->getFlimCalibDlg()->plotRoiPulse(m_pCalibPulse.raw_ptr(), x0 % m_pConfig->nTimes);
+						}
 				}
 			}
 
@@ -516,13 +575,18 @@ void QStreamTab::setFlimAcquisitionCallback()
 					recording_phase = false;
 			}
 
-			// Push the buffer to sync Queue
-			m_syncFlimProcessing.Queue_sync.push(pulse_ptr);
+			// Push the buffer to sync Queue (numbered for the in-order reassembly)
+			// Never waits inside the digitizer callback: a lane queue full of lent buffers drops the item (counted in the sync stats)
+			desc.stamp();
+			if (desc.lease < 0)
+				m_pEdgeFlimPulse->post(lane, pulse_ptr, desc);
+			else if (!m_pEdgeFlimPulse->lend(pulse_ptr, desc))
+				pDataAcq->ReleaseDaqBuffer(desc.lease); // lane queue full: dropped
 		}		
     });
 
     pDataAcq->ConnectDaqStopFlimData([&]() {
-		m_syncFlimProcessing.Queue_sync.push(nullptr);
+		m_pEdgeFlimPulse->close();
     });
 
     pDataAcq->ConnectDaqSendStatusMessage([&](const char * msg, bool is_error) {
@@ -535,60 +599,35 @@ void QStreamTab::setFlimAcquisitionCallback()
 void QStreamTab::setFlimProcessingCallback()
 {
     // FLIm Process Signal Objects /////////////////////////////////////////////////////////////////////////////////////////
-    FLImProcess *pFLIm = m_pOperationTab->getDataAcq()->getFLIm();
-    m_pThreadFlimProcess->DidAcquireData += [&, pFLIm] (int frame_count) {
-
-        // Get the buffer from the previous sync Queue
-        float* pulse_data = m_syncFlimProcessing.Queue_sync.pop();
-        if (pulse_data != nullptr)
-        {
-            // Get buffers from threading queues
-            float* flim_ptr = nullptr;
-            {
-                std::unique_lock<std::mutex> lock(m_syncFlimVisualization.mtx);
-
-                if (!m_syncFlimVisualization.queue_buffer.empty())
-                {
-                    flim_ptr = m_syncFlimVisualization.queue_buffer.front();
-                    m_syncFlimVisualization.queue_buffer.pop();
-                }
-            }
-
-            if (flim_ptr != nullptr)
-            {
-				// FLIm processing
-				np::FloatArray2 pulse(pulse_data, m_pConfig->nScans, m_pConfig->nTimes);
-
-                np::FloatArray2 intensity (flim_ptr + 0 * m_pConfig->nTimes, m_pConfig->nTimes, 4);
-                np::FloatArray2 mean_delay(flim_ptr + 4 * m_pConfig->nTimes, m_pConfig->nTimes, 4);
-                np::FloatArray2 lifetime  (flim_ptr + 8 * m_pConfig->nTimes, m_pConfig->nTimes, 3);
-								
-				(*pFLIm)(intensity, mean_delay, lifetime, pulse);
-
-                // Push the buffers to sync Queues
-                m_syncFlimVisualization.Queue_sync.push(flim_ptr);
-
-                // Return (push) the buffer to the previous threading queue
-                {
-                    std::unique_lock<std::mutex> lock(m_syncFlimProcessing.mtx);
-                    m_syncFlimProcessing.queue_buffer.push(pulse_data);
-                }
-            }
-        }
-        else
-            m_pThreadFlimProcess->_running = false;
-
-        (void)frame_count;
-    };
+    DataAcquisition* pDataAcq = m_pOperationTab->getDataAcq();
+    FLImProcess *pMaster = pDataAcq->getFLIm();
 
-    m_pThreadFlimProcess->DidStopData += [&]() {
-        m_syncFlimVisualization.Queue_sync.push(nullptr);
-    };
+    // One worker per lane: buffer -> FLImProcess of the worker -> result (same lane & sequence number)
+    PipelineTransform<uint16_t, float>* pStage = m_pPipelineFlim->addTransform<uint16_t, float>("FLIm image process", m_pEdgeFlimPulse, m_pEdgeFlimResult,
+        [&, pDataAcq, pMaster](int worker, uint16_t* pulse_data, float* flim_ptr) {
 
-    m_pThreadFlimProcess->SendStatusMessage += [&](const char* msg, bool is_error) {
-        if (is_error) m_pOperationTab->setAcquisitionButton(false);
-        QString qmsg = QString::fromUtf8(msg);
-        emit sendStatusMessage(qmsg, is_error);
+        FLImProcess *pFLIm = pDataAcq->getFLImWorker(worker);
+
+        // Follow the parameters of the master instance (calibration dialog)
+        if (pFLIm != pMaster)
+            pFLIm->syncParameters(*pMaster);
+
+        // FLIm processing
+        np::Uint16Array2 pulse(pulse_data, m_pConfig->nScans, m_pConfig->nTimes);
+
+        np::FloatArray2 intensity (getFlimResult(flim_ptr, FLIM_RESULT_INTENSITY), m_pConfig->nTimesBinned, 4);
+        np::FloatArray2 mean_delay(getFlimResult(flim_ptr, FLIM_RESULT_MEAN_DELAY), m_pConfig->nTimesBinned, 4);
+        np::FloatArray2 lifetime  (getFlimResult(flim_ptr, FLIM_RESULT_LIFETIME), m_pConfig->nTimesBinned, 3);
+
+        (*pFLIm)(intensity, mean_delay, lifetime, pulse);
+    }, pDataAcq->getPlacement(PLACEMENT_FLIM_PROCESSING));
+
+    // Worker statistics, from the worker thread once it has processed its last buffer
+    int n_workers = (int)pStage->threads.size();
+    pStage->DidDrain += [pDataAcq, pMaster, n_workers](int worker) {
+        FLImProcess *pFLIm = pDataAcq->getFLImWorker(worker);
+        pFLIm->reportIterations();
+        pFLIm->mergePhasorHistogram(*pMaster, n_workers);
     };
 }
 
@@ -601,30 +640,29 @@ void QStreamTab::setDpcAcquisitionCallback()
 		const uint16_t* frame_ptr = (uint16_t*)frame.raw_ptr();
 
 		// Get buffer from threading queue
-		uint16_t* image_ptr = nullptr;
-		{
-			std::unique_lock<std::mutex> lock(m_syncDpcProcessing.mtx);
-
-			if (!m_syncDpcProcessing.queue_buffer.empty())
-			{
-				image_ptr = m_syncDpcProcessing.queue_buffer.front();
-				m_syncDpcProcessing.queue_buffer.pop();
-			}
-		}
+		int lane;
+		uint16_t* image_ptr = m_pEdgeDpcImage->acquire(&lane);
 
 		if (image_ptr != nullptr)
 		{
+			// Frame descriptor (frame_count: illumination pattern of the camera cycle)
+			FrameDescriptor desc;
+			desc.seq = m_nDpcFrames++;
+			desc.timestamp_ns = FrameDescriptor::now();
+			desc.modality = FRAME_MODALITY_DPC;
+			desc.illum_pattern = frame_count;
+
 			// Body		
 			memcpy(image_ptr, frame_ptr, frame.length() * sizeof(uint16_t));
-			image_ptr[0] = (uint16_t)((double)frame_count / 10.0) * 10 + frame_count;
 				
 			// Push the buffer to sync Queue
-			m_syncDpcProcessing.Queue_sync.push(image_ptr);
+			desc.stamp();
+			m_pEdgeDpcImage->post(lane, image_ptr, desc);
 		}
 	});
 
 	pDataAcq->ConnectBrightfieldStopFlimData([&]() {
-		m_syncDpcProcessing.Queue_sync.push(nullptr);
+		m_pEdgeDpcImage->close();
 	});
 
 	pDataAcq->ConnectBrightfieldSendStatusMessage([&](const char * msg, bool is_error) {
@@ -637,404 +675,278 @@ void QStreamTab::setDpcAcquisitionCallback()
 void QStreamTab::setVisualizationCallback()
 {
     // Visualization Signal Objects ///////////////////////////////////////////////////////////////////////////////////////////
-    m_pThreadVisualization->DidAcquireData += [&] (int frame_count) {
+	StagePlacement* pPlacement = m_pOperationTab->getDataAcq()->getPlacement(PLACEMENT_VISUALIZATION);
+
+	// FLIm: frame assembly, display & recording (results in acquisition order)
+	m_pPipelineFlim->addSink<float>("FLIm visualization process", m_pEdgeFlimResult, [&](const FrameDescriptor& desc, float* flim_data) {
 
 		MemoryBuffer *pMemBuff = m_pOperationTab->m_pMemoryBuffer;
 
-		if (getCurrentModality())
+		// Body
+		if (m_pOperationTab->isAcquisitionButtonToggled()) // Only valid if acquisition is running 
 		{
-			// Get the buffers from the previous sync Queues
-			float* flim_data = m_syncFlimVisualization.Queue_sync.pop();
-			if (flim_data != nullptr)
+			// Effective lines
+			int effective_lines = GALVO_FLYING_BACK + m_pConfig->nLines + 2;
+			
+			// Averaging buffer (block: reset at the first frame of each average, running modes: kept until restarted)
+			if (m_nWrittenSamples == 0)
+			{
+				m_pFrameAverager->beginFrame(m_pConfig->nPixelsBinned, effective_lines, m_pConfig->imageAveragingMode,
+					m_pConfig->imageAveragingFrames, m_pConfig->imageAveragingAlpha, m_nAverageCount == 1);
+
+				//// Prevent mid-phase recording  (ù  )
+				//if (pMemBuff->m_bIsRecording && !m_bIsStageTransited)
+				//	m_bRecordingPhase = true;
+			}
+
+			// Data copy				
+			// (same blocks as the processing stage: stride nTimes, nTimesBinned samples used per row)
+			np::FloatView2 intensity(getFlimResult(flim_data, FLIM_RESULT_INTENSITY), m_pConfig->nTimesBinned, 4);
+			np::FloatView2 lifetime(getFlimResult(flim_data, FLIM_RESULT_LIFETIME), m_pConfig->nTimesBinned, 3);
+			m_pFrameAverager->accumulate(intensity, lifetime, m_nWrittenSamples, m_pConfig->nTimesBinned, m_pConfig->flimIntensityThres);
+			int written_lines = m_nWrittenSamples / m_pConfig->nPixelsBinned;
+			m_nWrittenSamples += m_pConfig->nTimesBinned;
+
+			// Frame assembly of the lines completed by this piece (rolling refresh instead of an end-of-frame burst):
+			// averaging over the valid samples, bi-directional mirroring & offset compensation and CRS nonlinearity compensation
+			// in one gather pass straight into the display (and recording) images
+			for (int line = written_lines; line < m_nWrittenSamples / m_pConfig->nPixelsBinned; line++)
 			{
-				// Body
-				if (m_pOperationTab->isAcquisitionButtonToggled()) // Only valid if acquisition is running 
+				int row = line - (GALVO_FLYING_BACK + 2);
+				if ((row < 0) || (row >= m_pConfig->nLines))
+					continue;
+
+				if (row == 0)
 				{
-					// Effective lines
-					int effective_lines = GALVO_FLYING_BACK + m_pConfig->nLines + 2;
-					
-					// Averaging buffer
-					if ((m_nAverageCount == 1) && (m_nWrittenSamples == 0))
+					// Bidirectional scan compensation published by the background estimator since the last frame
+					float bidir_comp;
+					if (m_pBidirEstimator->fetch(&bidir_comp, &m_nBidirRevision))
 					{
-						m_pTempIntensity = np::FloatArray2(m_pConfig->nPixels, 3 * effective_lines);
-						memset(m_pTempIntensity, 0, sizeof(float) * m_pTempIntensity.length());
-						m_pTempLifetime = np::FloatArray2(m_pConfig->nPixels, 3 * effective_lines);
-						memset(m_pTempLifetime, 0, sizeof(float) * m_pTempLifetime.length());
-						m_pNonNaNIndex = np::FloatArray2(m_pConfig->nPixels, 3 * effective_lines); //nPixels = 1000 , effective_lines = 1000 x 4 + galvo flying back 
-						ippsSet_32f(0.0f, m_pNonNaNIndex, m_pNonNaNIndex.length());
-
-						//// Prevent mid-phase recording  (ù  )
-						//if (pMemBuff->m_bIsRecording && !m_bIsStageTransited)
-						//	m_bRecordingPhase = true;
+						m_pConfig->biDirScanComp = bidir_comp;
+#if (FAST_DIR_FACTOR == 2)
+						emit setBiDirScanComp(bidir_comp);
+#endif
 					}
 
-					// Data copy				
-					np::FloatArray2 intensity(flim_data + 0 * m_pConfig->nTimes, m_pConfig->nTimes, 4);
-					np::FloatArray2 lifetime(flim_data + 8 * m_pConfig->nTimes, m_pConfig->nTimes, 3);
-					tbb::parallel_for(tbb::blocked_range<size_t>(0, 3),
-						[&](const tbb::blocked_range<size_t>& r) {
-						for (size_t i = r.begin(); i != r.end(); ++i)
-						{
-							ippsAdd_32f_I(&intensity(0, i + 1), &m_pTempIntensity(0, i * effective_lines) + m_nWrittenSamples, m_pConfig->nTimes);
-							ippsAdd_32f_I(&lifetime(0, i), &m_pTempLifetime(0, i * effective_lines) + m_nWrittenSamples, m_pConfig->nTimes);
-
-							for (int j = 0; j < m_pConfig->nTimes; j++)
-								if (intensity(j, i + 1) > INTENSITY_THRES)
-									*(&m_pNonNaNIndex(0, i * effective_lines) + m_nWrittenSamples + j) = *(&m_pNonNaNIndex(0, i * effective_lines) + m_nWrittenSamples + j) + 1.0f;
-						}
-					});
-					m_nWrittenSamples += m_pConfig->nTimes;
-
-					// Update Status
-					QString str; str.sprintf("Written: %7d / %7d   Avg: %3d / %3d   Rec: %3d / %3d", m_nWrittenSamples, m_pConfig->imageSize, m_nAverageCount - 1, m_pConfig->imageAveragingFrames, m_nImageCount, m_pConfig->imageStichingXStep * m_pConfig->imageStichingYStep);
-					emit setAcquisitionStatus(str);
+					// Compensation parameters & recording target of the whole frame
+					// (the CRS table follows the line width: recompiled only when nPixels or the binning changed)
+					bool crs = m_pCheckBox_CRSNonlinearityComp->isChecked() && m_pCrsTable->compile(m_pConfig->nPixels, m_pConfig->flimBinning);
+					m_pFrameAssembler->prepare(m_pConfig->nPixelsBinned, FAST_DIR_FACTOR == 2, m_pConfig->biDirScanComp / (float)m_pConfig->flimBinning,
+						crs ? m_pCrsTable->getIndex() : nullptr, crs ? m_pCrsTable->getWeight() : nullptr);
+
+					bool recorded = pMemBuff->m_bIsRecording && !m_bIsStageTransition && !m_bIsStageTransited
+						&& (m_nAverageCount >= m_pConfig->imageAveragingFrames) && (pMemBuff->m_nRecordedFrame < (int)pMemBuff->m_vectorWritingImageBuffer.size());
+					m_pRecordingImage = recorded ? pMemBuff->m_vectorWritingImageBuffer.at(pMemBuff->m_nRecordedFrame) : nullptr;
+					m_nRecordedRows = 0;
+					m_nDirtyRow = 0;
+				}
 
-					if (m_nWrittenSamples == (m_pConfig->imageSize + (GALVO_FLYING_BACK + 2) * m_pConfig->nPixels))
+				for (int i = 0; i < 3; i++)
+				{
+					int line0 = GALVO_FLYING_BACK + 2;
+					np::FloatArray2& vis_intensity = m_pVisualizationTab->m_vecVisIntensity.at(i);
+					np::FloatArray2& vis_lifetime = m_pVisualizationTab->m_vecVisLifetime.at(i);
+					(*m_pFrameAssembler)(vis_intensity.raw_ptr(), vis_lifetime.raw_ptr(),
+						m_pFrameAverager->getIntensity(i, line0), m_pFrameAverager->getLifetime(i, line0), m_pFrameAverager->getCount(i, line0), row, row + 1,
+						m_pFrameAverager->getLifetimeWeight(i, line0));
+
+					if (m_pRecordingImage)
 					{
-						// Averaging
-						tbb::parallel_for(tbb::blocked_range<size_t>(0, 3),
-							[&](const tbb::blocked_range<size_t>& r) {
-							for (size_t i = r.begin(); i != r.end(); ++i)
-							{
-								{
-									///ippsDivC_32f(&m_pTempIntensity(0, i * effective_lines + GALVO_FLYING_BACK + 2), m_nAverageCount, m_pVisualizationTab->m_vecVisIntensity.at(i).raw_ptr(), m_pConfig->imageSize);
-									///ippsDivC_32f(&m_pTempLifetime(0, i * effective_lines + GALVO_FLYING_BACK + 2), m_nAverageCount, m_pVisualizationTab->m_vecVisLifetime.at(i).raw_ptr(), m_pConfig->imageSize);
+						memcpy(m_pRecordingImage + i * vis_intensity.length() + row * m_pConfig->nPixelsBinned, &vis_intensity(0, row), sizeof(float) * m_pConfig->nPixelsBinned);
+						memcpy(m_pRecordingImage + (i + 3) * vis_lifetime.length() + row * m_pConfig->nPixelsBinned, &vis_lifetime(0, row), sizeof(float) * m_pConfig->nPixelsBinned);
+					}
+				}
+				if (m_pRecordingImage)
+					m_nRecordedRows++;
 
-									///ippsMul_32f_I(&m_pNonNaNIndex(0, i * effective_lines + GALVO_FLYING_BACK + 2), m_pVisualizationTab->m_vecVisIntensity.at(i).raw_ptr(), m_pConfig->imageSize);
-									///ippsMul_32f_I(&m_pNonNaNIndex(0, i * effective_lines + GALVO_FLYING_BACK + 2), m_pVisualizationTab->m_vecVisLifetime.at(i).raw_ptr(), m_pConfig->imageSize);
-								}
-								{
-									ippsDiv_32f(&m_pNonNaNIndex(0, i * effective_lines + GALVO_FLYING_BACK + 2), &m_pTempIntensity(0, i * effective_lines + GALVO_FLYING_BACK + 2),
-										m_pVisualizationTab->m_vecVisIntensity.at(i).raw_ptr(), m_pConfig->imageSize);
-									ippsDiv_32f(&m_pNonNaNIndex(0, i * effective_lines + GALVO_FLYING_BACK + 2), &m_pTempLifetime(0, i * effective_lines + GALVO_FLYING_BACK + 2),
-										m_pVisualizationTab->m_vecVisLifetime.at(i).raw_ptr(), m_pConfig->imageSize);
-								}
-							}
-						});
-						m_nAverageCount++;
+				// Draw the rows assembled since the last refresh
+				uint64_t now_ns = FrameDescriptor::now();
+				if ((row == m_pConfig->nLines - 1) || (now_ns - m_nLastRefresh_ns >= (uint64_t)ROLLING_REFRESH_MSEC * 1000000))
+				{
+					emit m_pVisualizationTab->drawImageRows(m_nDirtyRow, row + 1);
+					m_nDirtyRow = row + 1;
+					m_nLastRefresh_ns = now_ns;
+				}
+			}
 
-						// Bi-directional mirroring
-						if (FAST_DIR_FACTOR == 2)
-						{
-							tbb::parallel_for(tbb::blocked_range<size_t>(0, 3),
-								[&](const tbb::blocked_range<size_t>& r) {
-								for (size_t i = r.begin(); i != r.end(); ++i)								
-								{
-									// Mirroring
-									ippiMirror_32f_C1IR(&m_pVisualizationTab->m_vecVisIntensity.at(i)(0, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels, { m_pConfig->nPixels, m_pConfig->nLines / 2 }, ippAxsVertical);
-									ippiMirror_32f_C1IR(&m_pVisualizationTab->m_vecVisLifetime.at(i)(0, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels, { m_pConfig->nPixels, m_pConfig->nLines / 2 }, ippAxsVertical);
-	
-									// Offset compensation
-									np::FloatArray2 left(m_pConfig->nPixels, m_pConfig->nLines / 2);
-									np::FloatArray2 right(m_pConfig->nPixels, m_pConfig->nLines / 2);
+			// Update Status
+			QString str; str.sprintf("Written: %7d / %7d   Avg: %3d / %3d   Rec: %3d / %3d", m_nWrittenSamples, m_pConfig->imageSize, m_nAverageCount - 1, m_pConfig->imageAveragingFrames, m_nImageCount, m_pConfig->imageStichingXStep * m_pConfig->imageStichingYStep);
+			emit setAcquisitionStatus(str);
 
-									int shift = int(m_pConfig->biDirScanComp);
-									float comp = m_pConfig->biDirScanComp - shift;
+			if (m_nWrittenSamples == (m_pConfig->imageSize + (GALVO_FLYING_BACK + 2) * m_pConfig->nPixelsBinned))
+			{
+				// The rows are already assembled & drawn
+				m_nAverageCount++;
 
-									if (m_pConfig->biDirScanComp >= 0)
-									{
-										// Intensity
-										ippiCopy_32f_C1R(&m_pVisualizationTab->m_vecVisIntensity.at(i)(0, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels,
-											&left(shift, 0), sizeof(float) * m_pConfig->nPixels, { m_pConfig->nPixels - shift, m_pConfig->nLines / 2 });
-										ippiCopy_32f_C1R(&m_pVisualizationTab->m_vecVisIntensity.at(i)(0, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels,
-											&right(shift + 1, 0), sizeof(float) * m_pConfig->nPixels, { m_pConfig->nPixels - shift - 1, m_pConfig->nLines / 2 });
-
-										ippsMulC_32f_I(1.0f - comp, left, left.length());
-										ippsMulC_32f_I(comp, right, right.length());
-
-										ippiAdd_32f_C1R(left, sizeof(float) * m_pConfig->nPixels, right, sizeof(float) * m_pConfig->nPixels,
-											&m_pVisualizationTab->m_vecVisIntensity.at(i)(0, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels,
-											{ m_pConfig->nPixels, m_pConfig->nLines / 2 });
-
-										// Lifetime
-										ippiCopy_32f_C1R(&m_pVisualizationTab->m_vecVisLifetime.at(i)(0, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels,
-											&left(shift, 0), sizeof(float) * m_pConfig->nPixels, { m_pConfig->nPixels - shift, m_pConfig->nLines / 2 });
-										ippiCopy_32f_C1R(&m_pVisualizationTab->m_vecVisLifetime.at(i)(0, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels,
-											&right(shift + 1, 0), sizeof(float) * m_pConfig->nPixels, { m_pConfig->nPixels - shift - 1, m_pConfig->nLines / 2 });
-
-										ippsMulC_32f_I(1.0f - comp, left, left.length());
-										ippsMulC_32f_I(comp, right, right.length());
-
-										ippiAdd_32f_C1R(left, sizeof(float) * m_pConfig->nPixels, right, sizeof(float) * m_pConfig->nPixels,
-											&m_pVisualizationTab->m_vecVisLifetime.at(i)(0, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels,
-											{ m_pConfig->nPixels, m_pConfig->nLines / 2 });
-									}
-									else
-									{
-										// Intensity
-										ippiCopy_32f_C1R(&m_pVisualizationTab->m_vecVisIntensity.at(i)(-shift, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels,
-											&left(0, 0), sizeof(float) * m_pConfig->nPixels, { m_pConfig->nPixels + shift, m_pConfig->nLines / 2 });
-										ippiCopy_32f_C1R(&m_pVisualizationTab->m_vecVisIntensity.at(i)(-shift + 1, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels,
-											&right(0, 0), sizeof(float) * m_pConfig->nPixels, { m_pConfig->nPixels + shift - 1, m_pConfig->nLines / 2 });
-
-										ippsMulC_32f_I(1.0f + comp, left, left.length());
-										ippsMulC_32f_I(-comp, right, right.length());
-
-										ippiAdd_32f_C1R(left, sizeof(float) * m_pConfig->nPixels, right, sizeof(float) * m_pConfig->nPixels,
-											&m_pVisualizationTab->m_vecVisIntensity.at(i)(0, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels,
-											{ m_pConfig->nPixels, m_pConfig->nLines / 2 });
-
-										// Lifetime
-										ippiCopy_32f_C1R(&m_pVisualizationTab->m_vecVisLifetime.at(i)(-shift, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels,
-											&left(0, 0), sizeof(float) * m_pConfig->nPixels, { m_pConfig->nPixels + shift, m_pConfig->nLines / 2 });
-										ippiCopy_32f_C1R(&m_pVisualizationTab->m_vecVisLifetime.at(i)(-shift + 1, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels,
-											&right(0, 0), sizeof(float) * m_pConfig->nPixels, { m_pConfig->nPixels + shift - 1, m_pConfig->nLines / 2 });
-
-										ippsMulC_32f_I(1.0f + comp, left, left.length());
-										ippsMulC_32f_I(-comp, right, right.length());
-
-										ippiAdd_32f_C1R(left, sizeof(float) * m_pConfig->nPixels, right, sizeof(float) * m_pConfig->nPixels,
-											&m_pVisualizationTab->m_vecVisLifetime.at(i)(0, 1), sizeof(float) * FAST_DIR_FACTOR * m_pConfig->nPixels,
-											{ m_pConfig->nPixels, m_pConfig->nLines / 2 });
-									}
-								}
-							});
-						}
+				// Bidirectional scan compensation estimate (taken only when the estimator is idle)
+				if (m_pBidirEstimator->isRunning())
+				{
+					int ch = m_pConfig->flimEmissionChannel - 1, line0 = GALVO_FLYING_BACK + 2;
+					m_pBidirEstimator->offer(m_pFrameAverager->getIntensity(ch, line0), m_pFrameAverager->getCount(ch, line0),
+						m_pConfig->nPixelsBinned, m_pConfig->nLines, m_pConfig->flimBinning);
+				}
 
-						// CRS nonlinearity compensation
-						if (m_pCheckBox_CRSNonlinearityComp->isChecked())
+				// Draw histogram statistics
+				if (m_pDeviceControlTab->getFlimCalibDlg())
+					emit m_pDeviceControlTab->getFlimCalibDlg()->plotHistogram(m_pVisualizationTab->m_vecVisIntensity.at(m_pConfig->flimEmissionChannel - 1),
+						m_pVisualizationTab->m_vecVisLifetime.at(m_pConfig->flimEmissionChannel - 1));
+				
+				// Recording
+				if (!m_bIsStageTransition && !m_bIsStageTransited)
+				{
+					if (m_nAverageCount > m_pConfig->imageAveragingFrames)
+					{
+						if (pMemBuff->m_bIsRecording) //m_bRecordingPhase) <-  
 						{
-							np::FloatArray comp_index(&m_pCRSCompIdx(0, 0), m_pConfig->nPixels);
-							np::FloatArray comp_weight(&m_pCRSCompIdx(0, 1), m_pConfig->nPixels);
+							int n_total_images = m_pCheckBox_StitchingMode->isChecked() ? m_pConfig->imageStichingXStep * m_pConfig->imageStichingYStep : 1;
 
-							np::FloatArray2 scanArray0(m_pConfig->nPixels, m_pConfig->nLines);
-							np::FloatArray2 scanArray1(m_pConfig->nPixels, m_pConfig->nLines);
+							// Get buffer from writing queue
+							float* image_ptr = pMemBuff->m_vectorWritingImageBuffer.at(pMemBuff->m_nRecordedFrame);
 
-							for (int i = 0; i < 3; i++)
+							if (image_ptr != nullptr)
 							{
-								// Intensity
-								memcpy(scanArray0, m_pVisualizationTab->m_vecVisIntensity.at(i), sizeof(float) * m_pConfig->nPixels * m_pConfig->nLines);
-								
-								tbb::parallel_for(tbb::blocked_range<size_t>(0, (size_t)m_pConfig->nLines),
-									[&](const tbb::blocked_range<size_t>& r) {
-									for (size_t j = r.begin(); j != r.end(); ++j)
-									{
-										float* fast_scan = &scanArray0(0, (int)j);
-										float* comp_scan = &scanArray1(0, (int)j);
-
-										for (int k = 0; k < m_pConfig->nPixels; k++)
-										{
-											if (k != m_pConfig->nPixels - 1)
-												comp_scan[k] = comp_weight[k] * fast_scan[(int)comp_index[k]] + (1 - comp_weight[k]) * fast_scan[(int)comp_index[k] + 1];
-											else
-												comp_scan[k] = fast_scan[k];
-										}
-									}
-								});
-
-								memcpy(m_pVisualizationTab->m_vecVisIntensity.at(i), scanArray1, sizeof(float) * m_pConfig->nPixels * m_pConfig->nLines);
-
-								// Lifetime
-								memcpy(scanArray0, m_pVisualizationTab->m_vecVisLifetime.at(i), sizeof(float) * m_pConfig->nPixels * m_pConfig->nLines);
-
-								tbb::parallel_for(tbb::blocked_range<size_t>(0, (size_t)m_pConfig->nLines),
-									[&](const tbb::blocked_range<size_t>& r) {
-									for (size_t j = r.begin(); j != r.end(); ++j)
+								///if (!m_bIsGalvoOn)
+								///{
+								///if (0 == ((m_nImageCount + 1) / m_pConfig->imageStichingXStep + 1) % 2)
+								///	for (int i = 0; i < 3; i++)
+								///		ippiMirror_32f_C1IR(m_pVisualizationTab->m_vecVisIntensity.at(i).raw_ptr(), sizeof(float)* m_pConfig->nPixelsBinned, { m_pConfig->nPixelsBinned, m_pConfig->nLines }, ippAxsHorizontal);
+								///}
+
+								// Body (Copying the frame data, unless every row went to this buffer as it was assembled)
+								if ((image_ptr != m_pRecordingImage) || (m_nRecordedRows != m_pConfig->nLines))
+								{
+									for (int i = 0; i < 3; i++)
 									{
-										float* fast_scan = &scanArray0(0, (int)j);
-										float* comp_scan = &scanArray1(0, (int)j);
-
-										for (int k = 0; k < m_pConfig->nPixels; k++)
-										{
-											if (k != m_pConfig->nPixels - 1)
-												comp_scan[k] = comp_weight[k] * fast_scan[(int)comp_index[k]] + (1 - comp_weight[k]) * fast_scan[(int)comp_index[k] + 1];
-											else
-												comp_scan[k] = fast_scan[k];
-										}
+										memcpy(image_ptr + i * m_pVisualizationTab->m_vecVisIntensity.at(i).length(), m_pVisualizationTab->m_vecVisIntensity.at(i).raw_ptr(),
+											sizeof(float) * m_pVisualizationTab->m_vecVisIntensity.at(i).length());
+										memcpy(image_ptr + (i + 3) * m_pVisualizationTab->m_vecVisLifetime.at(i).length(), m_pVisualizationTab->m_vecVisLifetime.at(i).raw_ptr(),
+											sizeof(float) * m_pVisualizationTab->m_vecVisLifetime.at(i).length());
 									}
-								});
+								}
 
-								memcpy(m_pVisualizationTab->m_vecVisLifetime.at(i), scanArray1, sizeof(float) * m_pConfig->nPixels * m_pConfig->nLines);
+								pMemBuff->increaseRecordedFrame();
 							}
-						}
-
-						// Draw Images
-						emit m_pVisualizationTab->drawImage(getCurrentModality());
 
-						// Draw histogram statistics
-						if (m_pDeviceControlTab->getFlimCalibDlg())
-							emit m_pDeviceControlTab->getFlimCalibDlg()->plotHistogram(m_pVisualizationTab->m_vecVisIntensity.at(m_pConfig->flimEmissionChannel - 1),
-								m_pVisualizationTab->m_vecVisLifetime.at(m_pConfig->flimEmissionChannel - 1));
-						
-						// Recording
-						if (!m_bIsStageTransition && !m_bIsStageTransited)
-						{
-							if (m_nAverageCount > m_pConfig->imageAveragingFrames)
-							{
-								if (pMemBuff->m_bIsRecording) //m_bRecordingPhase) <-  
+							// Stage scanning for stitching
+							if (++m_nImageCount < n_total_images)
+							{										
+								if (m_nImageCount % m_pConfig->imageStichingXStep != 0) // x move
 								{
-									int n_total_images = m_pCheckBox_StitchingMode->isChecked() ? m_pConfig->imageStichingXStep * m_pConfig->imageStichingYStep : 1;
-
-									// Get buffer from writing queue
-									float* image_ptr = pMemBuff->m_vectorWritingImageBuffer.at(pMemBuff->m_nRecordedFrame);
-
-									if (image_ptr != nullptr)
-									{
-										///if (!m_bIsGalvoOn)
-										///{
-										///if (0 == ((m_nImageCount + 1) / m_pConfig->imageStichingXStep + 1) % 2)
-										///	for (int i = 0; i < 3; i++)
-										///		ippiMirror_32f_C1IR(m_pVisualizationTab->m_vecVisIntensity.at(i).raw_ptr(), sizeof(float)* m_pConfig->nPixels, { m_pConfig->nPixels, m_pConfig->nLines }, ippAxsHorizontal);
-										///}
-
-										// Body (Copying the frame data)
-										for (int i = 0; i < 3; i++)
-										{
-											memcpy(image_ptr + i * m_pVisualizationTab->m_vecVisIntensity.at(i).length(), m_pVisualizationTab->m_vecVisIntensity.at(i).raw_ptr(),
-												sizeof(float) * m_pVisualizationTab->m_vecVisIntensity.at(i).length());
-											memcpy(image_ptr + (i + 3) * m_pVisualizationTab->m_vecVisLifetime.at(i).length(), m_pVisualizationTab->m_vecVisLifetime.at(i).raw_ptr(),
-												sizeof(float) * m_pVisualizationTab->m_vecVisLifetime.at(i).length());
-										}
-
-										pMemBuff->increaseRecordedFrame();
-									}
-
-									// Stage scanning for stitching
-									if (++m_nImageCount < n_total_images)
-									{										
-										if (m_nImageCount % m_pConfig->imageStichingXStep != 0) // x move
-										{
-											int step = ((m_nImageCount / m_pConfig->imageStichingXStep + 1) % 2 ? -1 : +1) * m_pConfig->NanoscopeStep[1];
-											emit getDeviceControlTab()->startStageScan(2, step);
-										}
-										else // y move
-										{
-											emit getDeviceControlTab()->startStageScan(1, m_pConfig->NanoscopeStep[0]);
-										}
-									}
-
-									// Finish recording when the buffer is full
-									else
-									{
-										m_nImageCount = 0;
+									int step = ((m_nImageCount / m_pConfig->imageStichingXStep + 1) % 2 ? -1 : +1) * m_pConfig->NanoscopeStep[1];
+									emit getDeviceControlTab()->startStageScan(2, step);
+								}
+								else // y move
+								{
+									emit getDeviceControlTab()->startStageScan(1, m_pConfig->NanoscopeStep[0]);
+								}
+							}
 
-										pMemBuff->setIsRecorded(true);
-										pMemBuff->setIsRecording(true);
-										m_pOperationTab->setRecordingButton(false);
+							// Finish recording when the buffer is full
+							else
+							{
+								m_nImageCount = 0;
 
-										if (m_pCheckBox_StitchingMode->isChecked())
-										{
-											emit getDeviceControlTab()->startStageScan(2, (m_pConfig->imageStichingYStep % 2 == 0 ? 0 : m_pConfig->imageStichingXStep - 1) * m_pConfig->NanoscopeStep[1]);
-											emit getDeviceControlTab()->startStageScan(1, -(m_pConfig->imageStichingYStep - 1) * m_pConfig->NanoscopeStep[0]);
-										}
-									}
+								pMemBuff->setIsRecorded(true);
+								pMemBuff->setIsRecording(true);
+								m_pOperationTab->setRecordingButton(false);
 
-									// Reset flag
-									//m_bRecordingPhase = false;
+								if (m_pCheckBox_StitchingMode->isChecked())
+								{
+									emit getDeviceControlTab()->startStageScan(2, (m_pConfig->imageStichingYStep % 2 == 0 ? 0 : m_pConfig->imageStichingXStep - 1) * m_pConfig->NanoscopeStep[1]);
+									emit getDeviceControlTab()->startStageScan(1, -(m_pConfig->imageStichingYStep - 1) * m_pConfig->NanoscopeStep[0]);
 								}
-
-								m_nAverageCount = 1;
 							}
-						}
-						else
-						{
-							m_nAverageCount = 1;
-							m_bIsStageTransited = false;
+
+							// Reset flag
+							//m_bRecordingPhase = false;
 						}
 
-						// Re-initializing
-						m_nWrittenSamples = 0;
-						m_nAcquiredFrames++;
+						m_nAverageCount = 1;
 					}
 				}
-
-				// Return (push) the buffer to the previous threading queue
+				else
 				{
-					std::unique_lock<std::mutex> lock(m_syncFlimVisualization.mtx);
-					m_syncFlimVisualization.queue_buffer.push(flim_data);
+					m_nAverageCount = 1;
+					m_pFrameAverager->restart();
+					m_bIsStageTransited = false;
 				}
+
+				// Re-initializing
+				m_nWrittenSamples = 0;
+				m_nAcquiredFrames++;
 			}
-			else
-				m_pThreadVisualization->_running = false;
 		}
-		else
+
+		(void)desc;
+	}, pPlacement);
+
+	// DPC: display & recording
+	m_pPipelineDpc->addSink<uint16_t>("DPC visualization process", m_pEdgeDpcImage, [&](const FrameDescriptor& desc, uint16_t* image_data) {
+
+		MemoryBuffer *pMemBuff = m_pOperationTab->m_pMemoryBuffer;
+
+		// Body
+		if (m_pOperationTab->isAcquisitionButtonToggled()) // Only valid if acquisition is running 
 		{
-			uint16_t* image_data = m_syncDpcProcessing.Queue_sync.pop();
-			if (image_data != nullptr)
+			// Live CMOS mode
+			if (m_pVisualizationTab->getCurrentDpcImageMode() == DPC_LIVE)
+			{
+				// Data copy			
+				ippiConvert_16u32f_C1R(image_data, sizeof(uint16_t) * CMOS_WIDTH,
+					m_pVisualizationTab->m_liveIntensity, sizeof(float) * CMOS_WIDTH, { CMOS_WIDTH, CMOS_HEIGHT });
+
+				// Draw Images
+				emit m_pVisualizationTab->drawImage(getCurrentModality());
+			}
+			else if (m_pVisualizationTab->getCurrentDpcImageMode() == DPC_PROCESSED)
 			{
-				// Body
-				if (m_pOperationTab->isAcquisitionButtonToggled()) // Only valid if acquisition is running 
+				// Data copy			
+				ippiConvert_16u32f_C1R(image_data, sizeof(uint16_t) * CMOS_WIDTH,
+					m_pVisualizationTab->m_vecIllumImages.at(desc.illum_pattern), sizeof(float) * CMOS_WIDTH, { CMOS_WIDTH, CMOS_HEIGHT });
+
+				// Draw Images (last pattern of the cycle)
+				if (desc.illum_pattern == 3)
 				{
-					// Live CMOS mode
-					if (m_pVisualizationTab->getCurrentDpcImageMode() == DPC_LIVE)
-					{
-						// Data copy			
-						ippiConvert_16u32f_C1R(image_data, sizeof(uint16_t) * CMOS_WIDTH,
-							m_pVisualizationTab->m_liveIntensity, sizeof(float) * CMOS_WIDTH, { CMOS_WIDTH, CMOS_HEIGHT });
+					emit m_pVisualizationTab->drawImage(getCurrentModality());
 
-						// Draw Images
-						emit m_pVisualizationTab->drawImage(getCurrentModality());
-					}
-					else if (m_pVisualizationTab->getCurrentDpcImageMode() == DPC_PROCESSED)
+					// Recording
+					if (pMemBuff->m_bIsRecording)
 					{
-						// Data copy			
-						int pattern = image_data[0] - (uint16_t)((double)image_data[0] / 10.0) * 10;
-						ippiConvert_16u32f_C1R(image_data, sizeof(uint16_t) * CMOS_WIDTH,
-							m_pVisualizationTab->m_vecIllumImages.at(pattern), sizeof(float) * CMOS_WIDTH, { CMOS_WIDTH, CMOS_HEIGHT });
+						// Get buffer from writing queue
+						float* image_ptr = pMemBuff->m_vectorWritingImageBuffer.at(pMemBuff->m_nRecordedFrame);
 
-						// Draw Images
-						if (frame_count % 4 == 3)
+						if (image_ptr != nullptr)
 						{
-							emit m_pVisualizationTab->drawImage(getCurrentModality());
+							// Body (Copying the frame data)
+							pMemBuff->dpc_mode = m_pVisualizationTab->getCurrentDpcImageMode();
+							pMemBuff->dpc_illum = 0;
 
-							// Recording
-							if (pMemBuff->m_bIsRecording)
+							if (m_pVisualizationTab->getCurrentDpcImageMode() == DPC_LIVE)
 							{
-								// Get buffer from writing queue
-								float* image_ptr = pMemBuff->m_vectorWritingImageBuffer.at(pMemBuff->m_nRecordedFrame);
-
-								if (image_ptr != nullptr)
+								memcpy(image_ptr, m_pVisualizationTab->m_liveIntensity.raw_ptr(), sizeof(float) * m_pVisualizationTab->m_liveIntensity.length());
+								pMemBuff->dpc_illum = m_pDeviceControlTab->getDpcIllumPattern();
+							}
+							else if (m_pVisualizationTab->getCurrentDpcImageMode() == DPC_PROCESSED)
+							{
+								for (int i = 0; i < 4; i++)
 								{
-									// Body (Copying the frame data)
-									pMemBuff->dpc_mode = m_pVisualizationTab->getCurrentDpcImageMode();
-									pMemBuff->dpc_illum = 0;
-
-									if (m_pVisualizationTab->getCurrentDpcImageMode() == DPC_LIVE)
-									{
-										memcpy(image_ptr, m_pVisualizationTab->m_liveIntensity.raw_ptr(), sizeof(float) * m_pVisualizationTab->m_liveIntensity.length());
-										pMemBuff->dpc_illum = m_pDeviceControlTab->getDpcIllumPattern();
-									}
-									else if (m_pVisualizationTab->getCurrentDpcImageMode() == DPC_PROCESSED)
-									{
-										for (int i = 0; i < 4; i++)
-										{
-											memcpy(image_ptr + i * m_pVisualizationTab->m_vecIllumImages.at(i).length(), m_pVisualizationTab->m_vecIllumImages.at(i).raw_ptr(),
-												sizeof(float) * m_pVisualizationTab->m_vecIllumImages.at(i).length());
-										}
-									}
-
-									pMemBuff->increaseRecordedFrame();
-
-									// Finish recording when the buffer is full					
-									pMemBuff->setIsRecorded(true);
-									pMemBuff->setIsRecording(true);
-									m_pOperationTab->setRecordingButton(false);
+									memcpy(image_ptr + i * m_pVisualizationTab->m_vecIllumImages.at(i).length(), m_pVisualizationTab->m_vecIllumImages.at(i).raw_ptr(),
+										sizeof(float) * m_pVisualizationTab->m_vecIllumImages.at(i).length());
 								}
 							}
-						}
-					}									
-				}
 
-				// Return (push) the buffer to the previous threading queue
-				{
-					std::unique_lock<std::mutex> lock(m_syncDpcProcessing.mtx);
-					m_syncDpcProcessing.queue_buffer.push(image_data);
+							pMemBuff->increaseRecordedFrame();
+
+							// Finish recording when the buffer is full					
+							pMemBuff->setIsRecorded(true);
+							pMemBuff->setIsRecording(true);
+							m_pOperationTab->setRecordingButton(false);
+						}
+					}
 				}
-			}
-			else
-				m_pThreadVisualization->_running = false;
+			}									
 		}
-	};
-
-    m_pThreadVisualization->DidStopData += [&]() {
-        // None
-    };
-
-    m_pThreadVisualization->SendStatusMessage += [&](const char* msg, bool is_error) {
-        if (is_error) m_pOperationTab->setAcquisitionButton(false);
-        QString qmsg = QString::fromUtf8(msg);
-        emit sendStatusMessage(qmsg, is_error);
-    };
+	}, pPlacement);
 }
 
 
@@ -1073,6 +985,93 @@ void QStreamTab::onTimerMonitoring()
 		m_pMainWnd->m_pStatusLabel_Recording->setText("Recording X");
 		m_pMainWnd->m_pStatusLabel_Recording->setStyleSheet("color: red;");
 	}
+
+	// Stage boundary accounting
+	const char* boundary_name[3] = { "FLIm processing", "FLIm visualization", "DPC processing" };
+	SyncStats stats[3];
+	QString tooltip;
+	uint64_t total_drops = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		stats[i] = getSyncStats(i);
+		total_drops += stats[i].dropped;
+		tooltip += QString("%1: offered %2, accepted %3, dropped %4, depth %5 / %6 (high-water %7), blocked %8 ms, starved %9 ms%10")
+			.arg(boundary_name[i]).arg(stats[i].offered).arg(stats[i].accepted).arg(stats[i].dropped)
+			.arg(stats[i].depth).arg(stats[i].capacity).arg(stats[i].high_water)
+			.arg(stats[i].blocked_msec, 0, 'f', 1).arg(stats[i].starved_msec, 0, 'f', 1).arg((i < 2) ? "\n" : "");
+	}
+
+	m_pMainWnd->m_pStatusLabel_Dropped->setText(QString("Drop FP: %1 / FV: %2 / DPC: %3")
+		.arg(stats[SYNC_FLIM_PROCESSING].dropped).arg(stats[SYNC_FLIM_VISUALIZATION].dropped).arg(stats[SYNC_DPC_PROCESSING].dropped));
+	m_pMainWnd->m_pStatusLabel_Dropped->setStyleSheet(total_drops ? "color: red;" : "color: green;");
+
+	// End-to-end accounting of the frame descriptors at the sinks
+	Pipeline* pipelines[2] = { m_pPipelineFlim, m_pPipelineDpc };
+	for (int i = 0; i < 2; i++)
+		tooltip += QString("\n%1 end-to-end: %2").arg(QString::fromStdString(pipelines[i]->name)).arg(QString::fromStdString(pipelines[i]->monitor.report()));
+	m_pMainWnd->m_pStatusLabel_Dropped->setToolTip(tooltip);
+
+	// Log new drops (once per second)
+	if (++m_nMonitoringTicks % 10 == 0)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			if (stats[i].dropped != m_nReportedDrops[i])
+			{
+				char msg[256];
+				sprintf(msg, "[%s] %llu buffers dropped (total %llu of %llu offered, high-water %zu / %zu)", boundary_name[i],
+					(unsigned long long)(stats[i].dropped - m_nReportedDrops[i]), (unsigned long long)stats[i].dropped,
+					(unsigned long long)stats[i].offered, stats[i].high_water, stats[i].capacity);
+				processMessage(QString::fromUtf8(msg), false);
+				m_nReportedDrops[i] = stats[i].dropped;
+			}
+		}
+
+		for (int i = 0; i < 2; i++)
+		{
+			uint64_t lost = pipelines[i]->monitor.lost.load();
+			if (lost != m_nReportedLost[i])
+			{
+				char msg[512];
+				sprintf(msg, "[%s] %llu frames lost on the way (%s)", pipelines[i]->name.c_str(),
+					(unsigned long long)(lost - m_nReportedLost[i]), pipelines[i]->monitor.report().c_str());
+				processMessage(QString::fromUtf8(msg), false);
+				m_nReportedLost[i] = lost;
+			}
+		}
+	}
+}
+
+size_t QStreamTab::getFlimProcessingBufferQueueSize() const
+{
+	return m_pEdgeFlimPulse->freeBuffers();
+}
+
+size_t QStreamTab::getFlimVisualizationBufferQueueSize() const
+{
+	return m_pEdgeFlimResult->freeBuffers();
+}
+
+SyncStats QStreamTab::getSyncStats(int boundary) const
+{
+	switch (boundary)
+	{
+	case SYNC_FLIM_PROCESSING: return m_pEdgeFlimPulse->stats();
+	case SYNC_FLIM_VISUALIZATION: return m_pEdgeFlimResult->stats();
+	case SYNC_DPC_PROCESSING: return m_pEdgeDpcImage->stats();
+	default: return SyncStats();
+	}
+}
+
+void QStreamTab::resetSyncStats()
+{
+	m_pPipelineFlim->resetStats();
+	m_pPipelineDpc->resetStats();
+	for (int i = 0; i < 3; i++)
+		m_nReportedDrops[i] = 0;
+	for (int i = 0; i < 2; i++)
+		m_nReportedLost[i] = 0;
+	m_nDpcFrames = 0;
 }
 
 
@@ -1137,7 +1136,7 @@ void QStreamTab::changeModality(int modality)
 void QStreamTab::changeYLines(int n_lines)
 {
 	m_pConfig->nLines = n_lines;
-	m_pConfig->imageSize = m_pConfig->nPixels * m_pConfig->nLines;
+	m_pConfig->imageSize = m_pConfig->nPixelsBinned * m_pConfig->nLines;
     m_pVisualizationTab->setObjects(m_pConfig->nLines, getCurrentModality());
 
 	m_pOperationTab->getSaveButton()->setEnabled(false);
@@ -1157,146 +1156,26 @@ void QStreamTab::changeAveragingFrame(const QString &str)
 	m_pLabel_AcquisitionStatus->setText(str1);
 }
 
+void QStreamTab::changeAveragingMode(int mode)
+{
+	m_pConfig->imageAveragingMode = mode;
+}
+
 void QStreamTab::changeBiDirScanComp(double comp)
 {
 	m_pConfig->biDirScanComp = (float)comp;
 }
 
-void QStreamTab::autoCrsCompSet()
+void QStreamTab::autoCrsCompSet(bool toggled)
 {
-#if FAST_DIR_FACTOR == 2
-	////std::thread auto_comp([&]()
-	////{
-	//	// Set zero first
-	//	m_pDoubleSpinBox_BiDirScanComp->setValue(0.0);
-
-	//	std::this_thread::sleep_for(std::chrono::milliseconds(m_pConfig->nLines));
-
-	//	// Create buffer
-	//	np::FloatArray2 frame(m_pConfig->nPixels, m_pConfig->nLines);
-	//	ippsConvert_8u32f(m_pVisualizationTab->getImgObjIntensity()->arr, frame, frame.length());
-
-	//	np::FloatArray2 forward(m_pConfig->nPixels, m_pConfig->nLines / 2);
-	//	np::FloatArray2 backward(m_pConfig->nPixels, m_pConfig->nLines / 2);
-
-	//	ippiCopy_32f_C1R(&frame(0, 0), sizeof(float) * 2 * m_pConfig->nPixels,
-	//		forward, sizeof(float) * m_pConfig->nPixels,
-	//		{ m_pConfig->nPixels, m_pConfig->nLines / 2 });
-	//	ippiCopy_32f_C1R(&frame(0, 1), sizeof(float) * 2 * m_pConfig->nPixels,
-	//		backward, sizeof(float) * m_pConfig->nPixels,
-	//		{ m_pConfig->nPixels, m_pConfig->nLines / 2 });
-
-	//	ippsDivC_32f_I(255.0f, forward, forward.length());
-	//	ippsDivC_32f_I(255.0f, backward, backward.length());
-
-	//	// Spline parameters	
-	//	MKL_INT dorder = 1;
-	//	MKL_INT nx = 100 + 1; // original data length
-	//	MKL_INT nsite = 1000 + 1; // interpolated data length		
-	//	float x[2] = { 0.0f, (float)nx - 1.0f }; // data range
-	//	float* scoeff = new float[(nx - 1) * DF_PP_CUBIC];
-
-	//	// Correlation buffers
-	//	np::FloatArray corr_coefs0(nx);
-	//	np::FloatArray corr_coefs(nsite);
-
-	//	// Shifting along A-line dimension
-	//	//int k = 1;
-	//	for (int j = 0; j < nx; j++)
-	//	{
-	//		np::FloatArray fixed_vector, moving_vector;
-
-	//		Ipp32f x_mean, x_std;
-	//		Ipp32f y_mean, y_std;
-
-	//		if (j < 0)
-	//		{
-	//			// Fixed
-	//			fixed_vector = np::FloatArray((forward.size(0) + j) * forward.size(1));
-
-	//			ippiCopy_32f_C1R(&forward(-j, 0), sizeof(float) * forward.size(0),
-	//				fixed_vector, sizeof(float) * (forward.size(0) + j),
-	//				{ forward.size(0) + j, forward.size(1) });
-	//			ippsMeanStdDev_32f(fixed_vector, fixed_vector.length(), &x_mean, &x_std, ippAlgHintFast);
-	//			ippsSubC_32f_I(x_mean, fixed_vector, fixed_vector.length());
-
-	//			// Moving
-	//			moving_vector = np::FloatArray((backward.size(0) + j) * backward.size(1));
-
-	//			ippiCopy_32f_C1R(&backward(0, 0), sizeof(float) * backward.size(0),
-	//				moving_vector, sizeof(float) * (backward.size(0) + j),
-	//				{ backward.size(0) + j, backward.size(1) });
-	//			ippsMeanStdDev_32f(moving_vector, moving_vector.length(), &y_mean, &y_std, ippAlgHintFast);
-	//			ippsSubC_32f_I(y_mean, moving_vector, moving_vector.length());
-	//		}
-	//		else
-	//		{
-	//			// Fixed
-	//			fixed_vector = np::FloatArray((forward.size(0) - j) * forward.size(1));
-
-	//			ippiCopy_32f_C1R(&forward(0, 0), sizeof(float) * forward.size(0),
-	//				fixed_vector, sizeof(float) * (forward.size(0) - j),
-	//				{ forward.size(0) - j, forward.size(1) });
-	//			ippsMeanStdDev_32f(fixed_vector, fixed_vector.length(), &x_mean, &x_std, ippAlgHintFast);
-	//			ippsSubC_32f_I(x_mean, fixed_vector, fixed_vector.length());
-
-	//			// Moving
-	//			moving_vector = np::FloatArray((backward.size(0) - j) * backward.size(1));
-
-	//			ippiCopy_32f_C1R(&backward(j, 0), sizeof(float) * backward.size(0),
-	//				moving_vector, sizeof(float) * (backward.size(0) - j),
-	//				{ backward.size(0) - j, backward.size(1) });
-	//			ippsMeanStdDev_32f(moving_vector, moving_vector.length(), &y_mean, &y_std, ippAlgHintFast);
-	//			ippsSubC_32f_I(y_mean, moving_vector, moving_vector.length());
-	//		}
-
-	//		// Correlation coefficient
-	//		ippsMul_32f_I(fixed_vector, moving_vector, moving_vector.length());
-
-	//		Ipp32f cov;
-	//		ippsSum_32f(moving_vector, moving_vector.length(), &cov, ippAlgHintFast);
-	//		cov = cov / (moving_vector.length() - 1);
-
-	//		corr_coefs0(j) = cov / x_std / y_std * ((float)m_pConfig->nPixels / (float)(m_pConfig->nPixels - abs(j)));
-
-	//		//k++;
-	//	}
-
-	//	// Spline interpolation		
-	//	DFTaskPtr task1;
-	//	dfsNewTask1D(&task1, nx, x, DF_UNIFORM_PARTITION, 1, corr_coefs0.raw_ptr(), DF_MATRIX_STORAGE_ROWS);
-	//	dfsEditPPSpline1D(task1, DF_PP_CUBIC, DF_PP_NATURAL, DF_BC_NOT_A_KNOT, 0, DF_NO_IC, 0, scoeff, DF_NO_HINT);
-	//	dfsConstruct1D(task1, DF_PP_SPLINE, DF_METHOD_STD);
-	//	dfsInterpolate1D(task1, DF_INTERP, DF_METHOD_PP, nsite, x, DF_UNIFORM_PARTITION, 1, &dorder,
-	//		DF_NO_APRIORI_INFO, corr_coefs.raw_ptr(), DF_MATRIX_STORAGE_ROWS, NULL);
-	//	dfDeleteTask(&task1);
-	//	mkl_free_buffers();
-
-	//	delete[] scoeff;
-
-	//	QFile file("corr.data");
-	//	if (file.open(QIODevice::WriteOnly))
-	//	{
-	//		file.write(reinterpret_cast<char*>(corr_coefs.raw_ptr()), sizeof(float) * corr_coefs.length());
-	//		file.close();
-	//	}
-
-	//	// Find correction index
-	//	Ipp32f cmax; int cidx;
-	//	//ippsMaxIndx_32f(&corr_coefs[1000], (corr_coefs.length() - 1) / 2 + 1, &cmax, &cidx);
-	//	//float cidx1 = float(cidx) / 10.0f;
-
-	//	ippsMaxIndx_32f(corr_coefs0, corr_coefs0.length(), &cmax, &cidx);
-	//	float cidx1 = float(cidx); // / 10.0f;
-
-	//	ippsMaxIndx_32f(corr_coefs, corr_coefs.length(), &cmax, &cidx);
-	//	float cidx2 = float(cidx) / 10.0f;
-	//	printf("%f\n", cidx2);
-
-	//	m_pDoubleSpinBox_BiDirScanComp->setValue(cidx1);
-	////});
-	////auto_comp.detach();
-#endif
+	// Estimated on a low priority thread from the frames of the acquisition: the new shift is taken at the next frame
+	if (toggled)
+	{
+		m_pBidirEstimator->start(m_pConfig->biDirAutoTracking);
+		emit sendStatusMessage(QString("Bidirectional scan compensation: %1...").arg(m_pConfig->biDirAutoTracking ? "tracking" : "estimating"), false);
+	}
+	else
+		m_pBidirEstimator->stop();
 }
 
 void QStreamTab::changeCRSNonlinearityComp(bool toggled)
@@ -1304,38 +1183,14 @@ void QStreamTab::changeCRSNonlinearityComp(bool toggled)
 	m_pConfig->crsCompensation = toggled;
 	if (toggled)
 	{
-		QFile file("crs_comp_idx.txt");
-		if (false != file.open(QIODevice::ReadOnly))
-		{
-			QTextStream in(&file);
-
-			int i = 0;
-			while (!in.atEnd())
-			{
-				QString line = in.readLine();
-				QStringList comp_idx = line.split('\t');
-
-				m_pCRSCompIdx(i, 0) = comp_idx[0].toFloat();
-				m_pCRSCompIdx(i, 1) = comp_idx[1].toFloat();
-				i++;
-			}
-
-			file.close();
-		}
-		else
+		// Compiled table (binary sidecar crs_comp_idx.bin, rebuilt when the text file changed),
+		// resampled to the binned line by the frame assembly
+		if (!m_pCrsTable->load("crs_comp_idx.txt"))
 		{
 			m_pCheckBox_CRSNonlinearityComp->setChecked(false);
 			processMessage("No CRS nonlinearity compensation index file! (crs_comp_idx.txt)", true);
 		}
 	}
-	else
-	{
-		for (int i = 0; i < m_pConfig->nPixels; i++)
-		{
-			m_pCRSCompIdx(i, 0) = i;
-			m_pCRSCompIdx(i, 1) = 1;
-		}
-	}
 }
 
 void QStreamTab::changeCmosGain(int value)
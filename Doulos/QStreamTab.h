@@ -15,8 +15,13 @@ class QOperationTab;
 class QDeviceControlTab;
 class QVisualizationTab;
 
-class ThreadManager;
 class FLImProcess;
+class FrameAssembler;
+class FrameAverager;
+class CrsTable;
+class BidirEstimator;
+class Pipeline;
+template <typename T> class PipelineEdge;
 
 #define MODALITY_FLIM		0
 #define MODALITY_DPC		1
@@ -26,6 +31,21 @@ class FLImProcess;
 #define N_LINES_500			500
 #define N_LINES_1000		1000
 
+#define SYNC_FLIM_PROCESSING		0
+#define SYNC_FLIM_VISUALIZATION		1
+#define SYNC_DPC_PROCESSING			2
+
+#define ROLLING_REFRESH_MSEC		33 // display refresh of the rows assembled so far
+
+// FLIm result buffer (rows of nTimes floats, written by the processing stage & read by the visualization sink)
+#define FLIM_RESULT_INTENSITY		0 // 4 rows
+#define FLIM_RESULT_MEAN_DELAY		4 // 4 rows
+#define FLIM_RESULT_LIFETIME		8 // 3 rows
+#define FLIM_RESULT_ROWS			11
+
+static_assert((FLIM_RESULT_MEAN_DELAY == FLIM_RESULT_INTENSITY + 4) && (FLIM_RESULT_LIFETIME == FLIM_RESULT_MEAN_DELAY + 4)
+	&& (FLIM_RESULT_ROWS == FLIM_RESULT_LIFETIME + 3), "FLIm result blocks overlap");
+
 
 class QStreamTab : public QDialog
 {
@@ -46,8 +66,13 @@ public:
     inline QDeviceControlTab* getDeviceControlTab() const { return m_pDeviceControlTab; }
 	inline QVisualizationTab* getVisualizationTab() const { return m_pVisualizationTab; }
 
-	inline size_t getFlimProcessingBufferQueueSize() { return m_syncFlimProcessing.queue_buffer.size(); }
-	inline size_t getFlimVisualizationBufferQueueSize() { return m_syncFlimVisualization.queue_buffer.size(); }
+	size_t getFlimProcessingBufferQueueSize() const;
+	size_t getFlimVisualizationBufferQueueSize() const;
+
+	SyncStats getSyncStats(int boundary) const;
+	void resetSyncStats();
+
+	inline Pipeline* getPipeline(bool is_flim) const { return is_flim ? m_pPipelineFlim : m_pPipelineDpc; }
 
 	inline bool getCurrentModality() { return m_pRadioButton_FLIM->isChecked(); }
 
@@ -63,6 +88,10 @@ public:
 	void setAveragingWidgets(bool enabled);
 	void updateCmosGainExposure();
 
+private:
+	// Block of the FLIm result buffer: one stride (nTimes) for the producer & the consumer, whatever the binning
+	inline float* getFlimResult(float* flim_data, int block) const { return flim_data + block * m_pConfig->nTimes; }
+
 private:		
 // Set thread callback objects
     void setFlimAcquisitionCallback();
@@ -75,8 +104,9 @@ private slots:
 	void changeModality(int);
     void changeYLines(int);
 	void changeAveragingFrame(const QString &);
+	void changeAveragingMode(int);
 	void changeBiDirScanComp(double);
-	void autoCrsCompSet();
+	void autoCrsCompSet(bool);
 	void changeCRSNonlinearityComp(bool);
 	void changeCmosGain(int);
 	void changeCmosExposure(int);
@@ -88,6 +118,8 @@ private slots:
 signals:
     void sendStatusMessage(QString, bool);
 	void setAcquisitionStatus(QString);
+	void setBiDirScanComp(double);
+	void finishAutoCrsComp(bool);
 
 // Variables ////////////////////////////////////////////
 private:
@@ -108,8 +140,11 @@ public:
 	int m_nAverageCount;
 	bool m_bRecordingPhase;
 
-	// CRS nonlinearity compensation idx
-	np::FloatArray2 m_pCRSCompIdx;
+	// CRS nonlinearity compensation table (crs_comp_idx.txt)
+	CrsTable* m_pCrsTable;
+
+	// Converted records for FLIm calibration view
+	np::FloatArray2 m_pCalibPulse;
 
 	// Stitching flag
 	bool m_bIsStageTransition;
@@ -117,24 +152,38 @@ public:
 	int m_nImageCount;
 
 public:
-	// Image buffer
-	np::FloatArray2 m_pTempIntensity;
-	np::FloatArray2 m_pTempLifetime;
-	np::FloatArray2 m_pNonNaNIndex;
+	// Averaged lines (block, exponential or sliding window averaging)
+	FrameAverager* m_pFrameAverager;
 
-public:
-    // Thread manager objects
-    ThreadManager* m_pThreadFlimProcess;
-    ThreadManager* m_pThreadVisualization;
+	// Background bidirectional scan compensation estimate (parameter slot revision taken by the frame assembly)
+	BidirEstimator* m_pBidirEstimator;
+	uint32_t m_nBidirRevision;
+
+	// Per-line frame assembly (averaging, bidirectional & CRS compensation in one gather pass)
+	FrameAssembler* m_pFrameAssembler;
+	int m_nDirtyRow; // first row not drawn yet
+	uint64_t m_nLastRefresh_ns;
+	float* m_pRecordingImage; // writing buffer filled row by row (nullptr: frame not recorded)
+	int m_nRecordedRows;
 
 private:
-    // Thread synchronization objects
-    SyncObject<float> m_syncFlimProcessing;
-    SyncObject<float> m_syncFlimVisualization;
-	SyncObject<uint16_t> m_syncDpcProcessing;
+    // Stage graphs: acquisition -> FLIm workers -> visualization, acquisition -> visualization (DPC)
+    Pipeline* m_pPipelineFlim;
+    Pipeline* m_pPipelineDpc;
+
+    // Buffer pools between the stages (one lane per FLIm worker)
+    PipelineEdge<uint16_t>* m_pEdgeFlimPulse;
+    PipelineEdge<float>* m_pEdgeFlimResult;
+	PipelineEdge<uint16_t>* m_pEdgeDpcImage;
+
+	// Acquisition sequence number of the CMOS frames (the camera callback only passes the pattern index)
+	uint64_t m_nDpcFrames;
 
 	// Monitoring timer
 	QTimer *m_pTimer_Monitoring;
+	int m_nMonitoringTicks;
+	uint64_t m_nReportedDrops[3];
+	uint64_t m_nReportedLost[2];
 	
 private:
     // Layout
@@ -166,10 +215,11 @@ private:
 	// Image averaging mode 
 	QLabel *m_pLabel_Averaging;
 	QLineEdit *m_pLineEdit_Averaging;
+	QComboBox *m_pComboBox_AveragingMode;
 
 	QLabel *m_pLabel_AcquisitionStatus;
 	
-#if (CRS_DIR_FACTOR == 2)
+#if (FAST_DIR_FACTOR == 2)
 	// Bidirectional scan compensation
 	QLabel *m_pLabel_BiDirScanComp;
 	QDoubleSpinBox *m_pDoubleSpinBox_BiDirScanComp;
@@ -43,7 +43,7 @@ QVisualizationTab::QVisualizationTab(bool is_streaming, QWidget *parent) :
     m_pVBoxLayout->setSpacing(1);
 
     // Create image view
-    m_pImageView_Image = new QImageView(ColorTable::colortable(INTENSITY_COLORTABLE), m_pConfig->nPixels, m_pConfig->nLines);
+    m_pImageView_Image = new QImageView(ColorTable::colortable(INTENSITY_COLORTABLE), m_pConfig->nPixelsBinned, m_pConfig->nLines);
 	m_pImageView_Image->setMinimumSize(500, 500);
     m_pImageView_Image->setSquare(true);
 	m_pImageView_Image->setMovedMouseCallback([&](QPoint& p) { m_pStreamTab->getMainWnd()->m_pStatusLabel_ImagePos->setText(QString("(%1, %2)").arg(p.x(), 4).arg(p.y(), 4)); });
@@ -123,6 +123,7 @@ QVisualizationTab::QVisualizationTab(bool is_streaming, QWidget *parent) :
 
     // Connect signal and slot
     connect(this, SIGNAL(drawImage(bool)), this, SLOT(visualizeImage(bool)));
+	connect(this, SIGNAL(drawImageRows(int, int)), this, SLOT(visualizeImageRows(int, int)));
 	connect(this, SIGNAL(plotImage(uint8_t*)), m_pImageView_Image, SLOT(drawImage(uint8_t*)));
 
 	connect(this, SIGNAL(plotLiveImage(uint8_t*)), m_pImageView_Dpc[0], SLOT(drawImage(uint8_t*)));
@@ -507,23 +508,23 @@ void QVisualizationTab::setObjects(int n_lines, bool modality)
 		if (id == FLIM_IMAGE_INTENSITY)
 		{
 			m_pImageView_Image->resetColormap(ColorTable::colortable(INTENSITY_COLORTABLE));
-			m_pImageView_Image->resetSize(m_pConfig->nPixels, n_lines, false);
+			m_pImageView_Image->resetSize(m_pConfig->nPixelsBinned, n_lines, false);
 		}
 		else if (id == FLIM_IMAGE_LIFETIME)
 		{
 			m_pImageView_Image->resetColormap(ColorTable::colortable(m_pConfig->flimLifetimeColorTable));
-			m_pImageView_Image->resetSize(m_pConfig->nPixels, n_lines, false);
+			m_pImageView_Image->resetSize(m_pConfig->nPixelsBinned, n_lines, false);
 		}
 		else if (id == FLIM_IMAGE_MERGED)
 		{
-			m_pImageView_Image->resetSize(m_pConfig->nPixels, n_lines, true);
+			m_pImageView_Image->resetSize(m_pConfig->nPixelsBinned, n_lines, true);
 		}
 
 		// Create visualization buffers
 		for (int i = 0; i < 3; i++)
 		{
-			np::FloatArray2 intensity = np::FloatArray2(m_pConfig->nPixels, n_lines);
-			np::FloatArray2 lifetime = np::FloatArray2(m_pConfig->nPixels, n_lines);
+			np::FloatArray2 intensity = np::FloatArray2(m_pConfig->nPixelsBinned, n_lines);
+			np::FloatArray2 lifetime = np::FloatArray2(m_pConfig->nPixelsBinned, n_lines);
 			m_vecVisIntensity.push_back(intensity);
 			m_vecVisLifetime.push_back(lifetime);
 		}
@@ -531,13 +532,13 @@ void QVisualizationTab::setObjects(int n_lines, bool modality)
 		// Create image visualization buffers
 		ColorTable temp_ctable;
 		if (m_pImgObjIntensity) delete m_pImgObjIntensity;
-		m_pImgObjIntensity = new ImageObject(m_pConfig->nPixels, n_lines, temp_ctable.m_colorTableVector.at(INTENSITY_COLORTABLE));
+		m_pImgObjIntensity = new ImageObject(m_pConfig->nPixelsBinned, n_lines, temp_ctable.m_colorTableVector.at(INTENSITY_COLORTABLE));
 		if (m_pImgObjLifetime) delete m_pImgObjLifetime;
-		m_pImgObjLifetime = new ImageObject(m_pConfig->nPixels, n_lines, temp_ctable.m_colorTableVector.at(m_pConfig->flimLifetimeColorTable));
+		m_pImgObjLifetime = new ImageObject(m_pConfig->nPixelsBinned, n_lines, temp_ctable.m_colorTableVector.at(m_pConfig->flimLifetimeColorTable));
 		if (m_pImgObjMerged) delete m_pImgObjMerged;
-		m_pImgObjMerged = new ImageObject(m_pConfig->nPixels, n_lines, temp_ctable.m_colorTableVector.at(m_pConfig->flimLifetimeColorTable));
+		m_pImgObjMerged = new ImageObject(m_pConfig->nPixelsBinned, n_lines, temp_ctable.m_colorTableVector.at(m_pConfig->flimLifetimeColorTable));
 		if (m_pMedfilt) delete m_pMedfilt;
-		m_pMedfilt = new medfilt(m_pConfig->nPixels, n_lines, 3, 3);
+		m_pMedfilt = new medfilt(m_pConfig->nPixelsBinned, n_lines, 3, 3);
 	}
 	else
 	{
@@ -592,48 +593,7 @@ void QVisualizationTab::setObjects(int n_lines, bool modality)
 void QVisualizationTab::visualizeImage(bool modality)
 {
 	if (modality)
-	{
-		int id = m_pButtonGroup_ImageMode->checkedId();
-
-		IppiSize roi_flim = { m_pConfig->nPixels, m_pConfig->nLines };
-
-		// Intensity Image
-		float* scanIntensity = m_vecVisIntensity.at(m_pConfig->flimEmissionChannel - 1).raw_ptr();
-		ippiScale_32f8u_C1R(scanIntensity, sizeof(float) * roi_flim.width, m_pImgObjIntensity->arr.raw_ptr(), sizeof(uint8_t) * roi_flim.width,
-			roi_flim, m_pConfig->flimIntensityRange[m_pConfig->flimEmissionChannel - 1].min,
-			m_pConfig->flimIntensityRange[m_pConfig->flimEmissionChannel - 1].max);
-		//ippiTranspose_8u_C1IR(m_pImgObjIntensity->arr.raw_ptr(), roi_flim.width, roi_flim);
-		(*m_pMedfilt)(m_pImgObjIntensity->arr.raw_ptr());
-
-		// Lifetime Image
-		float* scanLifetime = m_vecVisLifetime.at(m_pConfig->flimEmissionChannel - 1).raw_ptr();
-		ippiScale_32f8u_C1R(scanLifetime, sizeof(float) * roi_flim.width, m_pImgObjLifetime->arr.raw_ptr(), sizeof(uint8_t) * roi_flim.width,
-			roi_flim, m_pConfig->flimLifetimeRange[m_pConfig->flimEmissionChannel - 1].min,
-			m_pConfig->flimLifetimeRange[m_pConfig->flimEmissionChannel - 1].max);
-		//ippiTranspose_8u_C1IR(m_pImgObjLifetime->arr.raw_ptr(), roi_flim.width, roi_flim);
-		(*m_pMedfilt)(m_pImgObjLifetime->arr.raw_ptr());
-
-		// Non HSV intensity-weight map
-		if (id == FLIM_IMAGE_MERGED)
-		{
-			ColorTable temp_ctable;
-			ImageObject tempImgObj(m_pImgObjMerged->getWidth(), m_pImgObjMerged->getHeight(), temp_ctable.m_colorTableVector.at(ColorTable::gray));
-
-			m_pImgObjLifetime->convertRgb();
-			memcpy(tempImgObj.qindeximg.bits(), m_pImgObjIntensity->arr.raw_ptr(), tempImgObj.qindeximg.byteCount());
-			tempImgObj.convertRgb();
-
-			ippsMul_8u_Sfs(m_pImgObjLifetime->qrgbimg.bits(), tempImgObj.qrgbimg.bits(), m_pImgObjMerged->qrgbimg.bits(), tempImgObj.qrgbimg.byteCount(), 8);
-		}
-
-		// Visualization
-		if (id == FLIM_IMAGE_INTENSITY)
-			emit plotImage(m_pImgObjIntensity->qindeximg.bits());
-		else if (id == FLIM_IMAGE_LIFETIME)
-			emit plotImage(m_pImgObjLifetime->qindeximg.bits());
-		else if (id == FLIM_IMAGE_MERGED)
-			emit plotImage(m_pImgObjMerged->qrgbimg.bits());
-	}
+		visualizeImageRows(0, m_pConfig->nLines);
 	else
 	{
 		int id = m_pButtonGroup_ImageModeDpc->checkedId();
@@ -682,22 +642,72 @@ void QVisualizationTab::visualizeImage(bool modality)
 	}
 }
 
+void QVisualizationTab::visualizeImageRows(int row0, int row1)
+{
+	int id = m_pButtonGroup_ImageMode->checkedId();
+
+	// A rolling refresh rescales only the updated rows, the others keep their previous contents.
+	// The median filter works in place: it runs once per frame, after rescaling the whole image.
+	bool frame_end = (row1 == m_pConfig->nLines);
+	if (frame_end) row0 = 0;
+
+	IppiSize roi_flim = { m_pConfig->nPixelsBinned, row1 - row0 };
+	int offset = row0 * m_pConfig->nPixelsBinned;
+
+	// Intensity Image
+	float* scanIntensity = m_vecVisIntensity.at(m_pConfig->flimEmissionChannel - 1).raw_ptr() + offset;
+	ippiScale_32f8u_C1R(scanIntensity, sizeof(float) * roi_flim.width, m_pImgObjIntensity->arr.raw_ptr() + offset, sizeof(uint8_t) * roi_flim.width,
+		roi_flim, m_pConfig->flimIntensityRange[m_pConfig->flimEmissionChannel - 1].min,
+		m_pConfig->flimIntensityRange[m_pConfig->flimEmissionChannel - 1].max);
+	//ippiTranspose_8u_C1IR(m_pImgObjIntensity->arr.raw_ptr(), roi_flim.width, roi_flim);
+	if (frame_end) (*m_pMedfilt)(m_pImgObjIntensity->arr.raw_ptr());
+
+	// Lifetime Image
+	float* scanLifetime = m_vecVisLifetime.at(m_pConfig->flimEmissionChannel - 1).raw_ptr() + offset;
+	ippiScale_32f8u_C1R(scanLifetime, sizeof(float) * roi_flim.width, m_pImgObjLifetime->arr.raw_ptr() + offset, sizeof(uint8_t) * roi_flim.width,
+		roi_flim, m_pConfig->flimLifetimeRange[m_pConfig->flimEmissionChannel - 1].min,
+		m_pConfig->flimLifetimeRange[m_pConfig->flimEmissionChannel - 1].max);
+	//ippiTranspose_8u_C1IR(m_pImgObjLifetime->arr.raw_ptr(), roi_flim.width, roi_flim);
+	if (frame_end) (*m_pMedfilt)(m_pImgObjLifetime->arr.raw_ptr());
+
+	// Non HSV intensity-weight map
+	if (id == FLIM_IMAGE_MERGED)
+	{
+		ColorTable temp_ctable;
+		ImageObject tempImgObj(m_pImgObjMerged->getWidth(), m_pImgObjMerged->getHeight(), temp_ctable.m_colorTableVector.at(ColorTable::gray));
+
+		m_pImgObjLifetime->convertRgb();
+		memcpy(tempImgObj.qindeximg.bits(), m_pImgObjIntensity->arr.raw_ptr(), tempImgObj.qindeximg.byteCount());
+		tempImgObj.convertRgb();
+
+		ippsMul_8u_Sfs(m_pImgObjLifetime->qrgbimg.bits(), tempImgObj.qrgbimg.bits(), m_pImgObjMerged->qrgbimg.bits(), tempImgObj.qrgbimg.byteCount(), 8);
+	}
+
+	// Visualization
+	if (id == FLIM_IMAGE_INTENSITY)
+		emit plotImage(m_pImgObjIntensity->qindeximg.bits());
+	else if (id == FLIM_IMAGE_LIFETIME)
+		emit plotImage(m_pImgObjLifetime->qindeximg.bits());
+	else if (id == FLIM_IMAGE_MERGED)
+		emit plotImage(m_pImgObjMerged->qrgbimg.bits());
+}
+
 
 void QVisualizationTab::changeFlimImageMode(int mode)
 {
 	if (mode == FLIM_IMAGE_INTENSITY)
 	{
 		m_pImageView_Image->resetColormap(ColorTable::colortable(INTENSITY_COLORTABLE));
-		m_pImageView_Image->resetSize(m_pConfig->nPixels, m_pConfig->nLines, false);
+		m_pImageView_Image->resetSize(m_pConfig->nPixelsBinned, m_pConfig->nLines, false);
 	}
 	else if (mode == FLIM_IMAGE_LIFETIME)
 	{
 		m_pImageView_Image->resetColormap(ColorTable::colortable(m_pConfig->flimLifetimeColorTable));
-		m_pImageView_Image->resetSize(m_pConfig->nPixels, m_pConfig->nLines, false);
+		m_pImageView_Image->resetSize(m_pConfig->nPixelsBinned, m_pConfig->nLines, false);
 	}
 	else if (mode == FLIM_IMAGE_MERGED)
 	{
-		m_pImageView_Image->resetSize(m_pConfig->nPixels, m_pConfig->nLines, true);
+		m_pImageView_Image->resetSize(m_pConfig->nPixelsBinned, m_pConfig->nLines, true);
 	}
 
     visualizeImage(m_pStreamTab->getCurrentModality());
@@ -740,9 +750,9 @@ void QVisualizationTab::changeLifetimeColorTable(int ctable_ind)
 
     ColorTable temp_ctable;
     if (m_pImgObjLifetime) delete m_pImgObjLifetime;
-    m_pImgObjLifetime = new ImageObject(m_pConfig->nPixels, m_pConfig->nLines, temp_ctable.m_colorTableVector.at(ctable_ind));
+    m_pImgObjLifetime = new ImageObject(m_pConfig->nPixelsBinned, m_pConfig->nLines, temp_ctable.m_colorTableVector.at(ctable_ind));
 	if (m_pImgObjMerged) delete m_pImgObjMerged;
-	m_pImgObjMerged = new ImageObject(m_pConfig->nPixels, m_pConfig->nLines, temp_ctable.m_colorTableVector.at(m_pConfig->flimLifetimeColorTable));
+	m_pImgObjMerged = new ImageObject(m_pConfig->nPixelsBinned, m_pConfig->nLines, temp_ctable.m_colorTableVector.at(m_pConfig->flimLifetimeColorTable));
 
     visualizeImage(m_pStreamTab->getCurrentModality());
 }
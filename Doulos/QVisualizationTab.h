@@ -65,6 +65,7 @@ public:
 
 public slots:
     void visualizeImage(bool modality);
+	void visualizeImageRows(int row0, int row1); // FLIm: rows [row0, row1) updated (rolling refresh)
 
 private slots:
     void changeFlimImageMode(int);
@@ -80,6 +81,7 @@ private slots:
 
 signals:
     void drawImage(bool);
+	void drawImageRows(int, int);
 	void plotImage(uint8_t*);
 	void plotLiveImage(uint8_t*);
 	void plotDpcTbImage(uint8_t*);
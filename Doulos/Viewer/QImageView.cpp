@@ -3,6 +3,8 @@
 #include "QImageView.h"
 #include <ipps.h>
 
+#include <Common/Tracer.h>
+
 
 ColorTable::ColorTable()
 {
@@ -287,6 +289,8 @@ QRenderImage::~QRenderImage()
 
 void QRenderImage::paintEvent(QPaintEvent *)
 {
+    TRACE_SCOPE("QRenderImage paint");
+
     QPainter painter(this);
 	painter.setRenderHint(QPainter::Antialiasing, true);
 
@@ -15,6 +15,9 @@
 #include <DataAcquisition/QpiProcess/QpiProcess.h>
 
 #include <Common/ImageObject.h>
+#include <Common/ThreadPlacement.h>
+#include <Common/Tracer.h>
+#include <Common/RealTime.h>
 #include <Common/medfilt.h>
 
 #include <iostream>
@@ -31,7 +34,8 @@
 MemoryBuffer::MemoryBuffer(QObject *parent) :
     QObject(parent), m_bIsAllocatedWritingBuffer(false),
 	m_bIsRecorded(false), m_bIsRecording(false), 
-	m_bIsSaved(false), m_nRecordedFrame(0), is_flim(true), dpc_mode(-1), dpc_illum(0)
+	m_bIsSaved(false), m_nRecordedFrame(0), is_flim(true), dpc_mode(-1), dpc_illum(0),
+	m_nImageBufferBytes(0), m_nPulseBufferBytes(0)
 {
 	m_pOperationTab = (QOperationTab*)parent;
 	m_pConfig = m_pOperationTab->getStreamTab()->getMainWnd()->m_pConfiguration;
@@ -49,7 +53,7 @@ void MemoryBuffer::allocateWritingBuffer(bool _is_flim)
 	is_flim = _is_flim;
 	deallocateWritingBuffer();
 	{
-		// Image buffer
+		// Image buffer (prefaulted & locked: no page faults on the first pass of a recording)
 		int buffer_number = WRITING_IMAGE_SIZE;
 		for (int i = 0; i < buffer_number; i++)
 		{
@@ -57,12 +61,16 @@ void MemoryBuffer::allocateWritingBuffer(bool _is_flim)
 			{
 				float *writingImageBuffer = new float[6 * m_pConfig->imageSize];
 				memset(writingImageBuffer, 0, 6 * m_pConfig->imageSize * sizeof(float));
+				m_nImageBufferBytes = 6 * m_pConfig->imageSize * sizeof(float);
+				RealTime::prefault(writingImageBuffer, m_nImageBufferBytes);
 				m_vectorWritingImageBuffer.push_back(writingImageBuffer);
 			}
 			else
 			{
 				float *writingImageBuffer = new float[4 * CMOS_WIDTH * CMOS_HEIGHT];
 				memset(writingImageBuffer, 0, 4 * CMOS_WIDTH * CMOS_HEIGHT * sizeof(float));
+				m_nImageBufferBytes = 4 * CMOS_WIDTH * CMOS_HEIGHT * sizeof(float);
+				RealTime::prefault(writingImageBuffer, m_nImageBufferBytes);
 				m_vectorWritingImageBuffer.push_back(writingImageBuffer);
 			}
 		}
@@ -71,13 +79,16 @@ void MemoryBuffer::allocateWritingBuffer(bool _is_flim)
 		if (is_flim)
 		{
 			buffer_number = 2 * (m_pConfig->nLines + GALVO_FLYING_BACK + 2);
+			m_nPulseBufferBytes = m_pConfig->nScans * m_pConfig->nTimes * sizeof(uint16_t);
 			for (int i = 0; i < buffer_number; i++)
 			{
 				uint16_t *writingPulseBuffer = new uint16_t[m_pConfig->nScans * m_pConfig->nTimes];
 				memset(writingPulseBuffer, 0, m_pConfig->nScans * m_pConfig->nTimes * sizeof(uint16_t));
+				RealTime::prefault(writingPulseBuffer, m_nPulseBufferBytes);
 				m_vectorWritingPulseBuffer.push_back(writingPulseBuffer);
 			}		
 		}
+		SendStatusMessage(RealTime::report().c_str(), false);
 		
 		// Allocation result
 		if (is_flim)
@@ -111,6 +122,7 @@ void MemoryBuffer::deallocateWritingBuffer()
 			{
 				if (m_vectorWritingImageBuffer.at(i))
 				{
+					RealTime::release(m_vectorWritingImageBuffer.at(i), m_nImageBufferBytes);
 					delete[] m_vectorWritingImageBuffer.at(i);
 					m_vectorWritingImageBuffer.at(i) = nullptr;
 				}
@@ -128,6 +140,7 @@ void MemoryBuffer::deallocateWritingBuffer()
 			{
 				if (m_vectorWritingPulseBuffer.at(i))
 				{
+					RealTime::release(m_vectorWritingPulseBuffer.at(i), m_nPulseBufferBytes);
 					delete[] m_vectorWritingPulseBuffer.at(i);
 					m_vectorWritingPulseBuffer.at(i) = nullptr;
 				}
@@ -245,8 +258,9 @@ bool MemoryBuffer::startSaving()
 	
 	if (m_fileName == "") return false;
 	
-	// Start writing thread
-	std::thread _thread = std::thread(&MemoryBuffer::write, this);
+	// Start writing thread (on the writer cpu set & arena)
+	StagePlacement* pPlacement = m_pOperationTab->getDataAcq()->getPlacement(PLACEMENT_WRITER);
+	std::thread _thread = std::thread([&, pPlacement]() { pPlacement->run([&]() { write(); }); });
 	_thread.detach();
 
 	return true;
@@ -278,6 +292,9 @@ bool MemoryBuffer::startSaving()
 
 void MemoryBuffer::write()
 {	
+	TRACE_THREAD_NAME("Writer");
+	TRACE_SCOPE("MemoryBuffer write");
+
 	qint64 res;
 	qint64 samplesToWrite;
 	if (is_flim)
@@ -312,6 +329,7 @@ void MemoryBuffer::write()
 			for (int i = 0; i < m_nRecordedFrame; i++)
 			{
 				// FLIm raw image writing		
+				TRACE_SCOPE("Write raw frame");
 				res = file.write(reinterpret_cast<char*>(m_vectorWritingImageBuffer.at(i)), sizeof(float) * samplesToWrite);
 				if (!(res == sizeof(float) * samplesToWrite))
 				{
@@ -328,11 +346,13 @@ void MemoryBuffer::write()
 		QDir().mkpath(path);
 		for (int i = 0; i < m_nRecordedFrame; i++)
 		{
+			TRACE_SCOPE("Write scaled frame");
+
 			// FLIm scaled image writing
 			if (is_flim)
 			{
 				ColorTable temp_ctable;
-				IppiSize roi_flim = { m_pConfig->nPixels, m_pConfig->nLines };
+				IppiSize roi_flim = { m_pConfig->nPixelsBinned, m_pConfig->nLines };
 
 				ImageObject imgObjIntensity(roi_flim.width, roi_flim.height, temp_ctable.m_colorTableVector.at(INTENSITY_COLORTABLE));
 				ImageObject imgObjLifetime(roi_flim.width, roi_flim.height, temp_ctable.m_colorTableVector.at(m_pConfig->flimLifetimeColorTable));
@@ -73,6 +73,7 @@ public:
 public:
     std::vector<float*> m_vectorWritingImageBuffer; // writing buffer
 	std::vector<uint16_t*> m_vectorWritingPulseBuffer; // pulse buffer
+	size_t m_nImageBufferBytes, m_nPulseBufferBytes; // per buffer (prefaulted & locked)
 	QString m_fileName;
 };
 